@@ -0,0 +1,285 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Массив значений, который либо хранится в собственном std::vector, либо ссылается на чужую память —
+// обычно участок отображённого в память файла индекса (см. index_file.h). Читается одинаково в обоих
+// случаях. Перед первым изменением ссылающийся столбец копирует значения к себе.
+template <typename T>
+class Column {
+public:
+    using const_iterator = const T*;
+
+    Column() = default;
+
+    explicit Column(size_t size, const T& value = T())
+        : storage_(size, value) {
+        Bind();
+    }
+
+    explicit Column(std::vector<T> values)
+        : storage_(std::move(values)) {
+        Bind();
+    }
+
+    // Столбец поверх чужой памяти; owner продлевает ей жизнь
+    Column(const T* data, size_t size, std::shared_ptr<const void> owner)
+        : data_(data)
+        , size_(size)
+        , owner_(std::move(owner)) {
+    }
+
+    Column(const Column& other)
+        : storage_(other.storage_)
+        , owner_(other.owner_) {
+        BindTo(other);
+    }
+
+    Column(Column&& other) noexcept
+        : storage_(std::move(other.storage_))
+        , owner_(std::move(other.owner_)) {
+        BindTo(other);
+        other.storage_.clear();
+        other.Bind();
+    }
+
+    Column& operator=(const Column& other) {
+        if (this != &other) {
+            storage_ = other.storage_;
+            owner_ = other.owner_;
+            BindTo(other);
+        }
+        return *this;
+    }
+
+    Column& operator=(Column&& other) noexcept {
+        if (this != &other) {
+            storage_ = std::move(other.storage_);
+            owner_ = std::move(other.owner_);
+            BindTo(other);
+            other.storage_.clear();
+            other.Bind();
+        }
+        return *this;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    const T* Data() const {
+        return data_;
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    const T& Back() const {
+        return data_[size_ - 1];
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+    // true, если значения лежат в чужой памяти
+    bool IsMapped() const {
+        return owner_ != nullptr;
+    }
+
+    T* MutableData() {
+        Own();
+        return storage_.data();
+    }
+
+    void PushBack(const T& value) {
+        Own();
+        storage_.push_back(value);
+        Bind();
+    }
+
+    void Resize(size_t size, const T& value = T()) {
+        Own();
+        storage_.resize(size, value);
+        Bind();
+    }
+
+    void Reserve(size_t capacity) {
+        Own();
+        storage_.reserve(capacity);
+        Bind();
+    }
+
+    void Assign(size_t size, const T& value) {
+        owner_.reset();
+        storage_.assign(size, value);
+        Bind();
+    }
+
+    void Insert(size_t position, const T& value) {
+        Own();
+        storage_.insert(storage_.begin() + position, value);
+        Bind();
+    }
+
+    void Erase(size_t first, size_t last) {
+        Own();
+        storage_.erase(storage_.begin() + first, storage_.begin() + last);
+        Bind();
+    }
+
+    void ShrinkToFit() {
+        Own();
+        storage_.shrink_to_fit();
+        Bind();
+    }
+
+private:
+    std::vector<T> storage_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+    std::shared_ptr<const void> owner_;
+
+    void Bind() {
+        data_ = storage_.data();
+        size_ = storage_.size();
+    }
+
+    void BindTo(const Column& other) {
+        if (owner_) {
+            data_ = other.data_;
+            size_ = other.size_;
+        }
+        else {
+            Bind();
+        }
+    }
+
+    void Own() {
+        if (owner_) {
+            storage_.assign(data_, data_ + size_);
+            owner_.reset();
+            Bind();
+        }
+    }
+};
+
+// Непрерывный участок значений: строка RaggedColumn
+template <typename T>
+class ColumnRow {
+public:
+    ColumnRow() = default;
+
+    ColumnRow(const T* data, size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    const T* Data() const {
+        return data_;
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Строки значений переменной длины по номеру. Первые строки могут лежать в чужой памяти в формате CSR
+// (значения подряд и границы строк), следующие хранятся каждая в своём векторе, поэтому их можно
+// дописывать, заполнять параллельно и освобождать по одной.
+template <typename T>
+class RaggedColumn {
+public:
+    RaggedColumn() = default;
+
+    // Строки в формате CSR: строка i — значения [offsets[i], offsets[i + 1])
+    RaggedColumn(Column<uint64_t> offsets, Column<T> values)
+        : base_offsets_(std::move(offsets))
+        , base_values_(std::move(values)) {
+    }
+
+    size_t RowCount() const {
+        return GetBaseRowCount() + rows_.size();
+    }
+
+    // Бросает std::runtime_error, если границы строки CSR выходят за её значения
+    ColumnRow<T> GetRow(size_t row) const {
+        const size_t base_row_count = GetBaseRowCount();
+        if (row < base_row_count) {
+            // границы строк из файла проверяются при чтении строки, а не все сразу при открытии
+            const uint64_t first = base_offsets_[row];
+            const uint64_t last = base_offsets_[row + 1];
+            if (first > last || last > base_values_.Size()) {
+                throw std::runtime_error("ragged column row is out of range");
+            }
+            return { base_values_.Data() + first, static_cast<size_t>(last - first) };
+        }
+        const std::vector<T>& values = rows_[row - base_row_count];
+        return { values.data(), values.size() };
+    }
+
+    void AppendRow(std::vector<T> values) {
+        rows_.push_back(std::move(values));
+    }
+
+    // Дописывает пустые строки, пока их не станет row_count
+    void ResizeRows(size_t row_count) {
+        rows_.resize(row_count - GetBaseRowCount());
+    }
+
+    // Строку, дописанную после строк CSR, можно менять на месте; разные строки — из разных потоков
+    std::vector<T>& GetMutableRow(size_t row) {
+        return rows_[row - GetBaseRowCount()];
+    }
+
+    // Освобождает память строки; строки CSR лежат в чужой памяти и остаются как есть
+    void ReleaseRow(size_t row) {
+        if (row >= GetBaseRowCount()) {
+            std::vector<T>().swap(GetMutableRow(row));
+        }
+    }
+
+private:
+    Column<uint64_t> base_offsets_;
+    Column<T> base_values_;
+    std::vector<std::vector<T>> rows_;
+
+    size_t GetBaseRowCount() const {
+        return base_offsets_.Empty() ? 0 : base_offsets_.Size() - 1;
+    }
+};
@@ -0,0 +1,131 @@
+﻿#include "concurrent_search_server.h"
+
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+ConcurrentSearchServer::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : server_(other.server_)
+    , slot_(other.slot_) {
+    other.slot_ = nullptr;
+}
+
+ConcurrentSearchServer::Snapshot::~Snapshot() {
+    if (slot_ != nullptr) {
+        slot_->count.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// Читатель отмечается в счётчике копии и затем убеждается, что она всё ещё опубликована:
+// пишущий поток, начавший менять копию, увидит либо отметку, либо читатель увидит новую публикацию
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::GetSnapshot() const {
+    thread_local const size_t slot_index = std::hash<std::thread::id>()(std::this_thread::get_id()) % READER_SLOT_COUNT;
+    while (true) {
+        const int published = published_.load();
+        ReaderSlot& slot = readers_[published][slot_index];
+        slot.count.fetch_add(1);
+        if (published_.load() == published) {
+            return Snapshot(servers_[published].get(), &slot);
+        }
+        slot.count.fetch_sub(1);
+    }
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Write([document_id, text = std::string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, text, status, ratings);
+        });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    // тексты копируются: изменение повторяется на второй копии уже после возврата из вызова
+    std::vector<std::string> texts;
+    texts.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        texts.emplace_back(document.text);
+    }
+    Write([documents, texts = std::move(texts)](SearchServer& server) {
+        std::vector<NewDocument> own_documents = documents;
+        for (size_t i = 0; i < own_documents.size(); ++i) {
+            own_documents[i].text = texts[i];
+        }
+        server.AddDocuments(std::execution::par, own_documents);
+        });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+        });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    Write([document_ids](SearchServer& server) {
+        server.RemoveDocuments(std::execution::par, document_ids);
+        });
+}
+
+void ConcurrentSearchServer::Freeze() {
+    Write([](SearchServer& server) {
+        server.Freeze();
+        });
+}
+
+// Изменения детерминированы, поэтому на второй копии они дают то же состояние и то же исключение
+// std::invalid_argument. Любое другое исключение (нехватка памяти) оставляет копию изменённой
+// частично, и тогда она целиком копируется с опубликованной. Если не удалось и копирование,
+// исключение уходит вызывающему, а копия остаётся помеченной и копируется при следующем изменении.
+void ConcurrentSearchServer::SynchronizeHidden(int hidden) {
+    if (!is_hidden_stale_) {
+        try {
+            for (const Update& pending_update : pending_updates_) {
+                try {
+                    pending_update(*servers_[hidden]);
+                }
+                catch (const std::invalid_argument&) {
+                }
+            }
+        }
+        catch (...) {
+            is_hidden_stale_ = true;
+        }
+    }
+    if (is_hidden_stale_) {
+        servers_[hidden] = std::make_unique<SearchServer>(*servers_[1 - hidden]);
+        is_hidden_stale_ = false;
+    }
+    pending_updates_.clear();
+}
+
+// Исключение std::invalid_argument первого применения пробрасывается вызывающему уже после публикации:
+// документы, добавленные до ошибочного, должны стать видны, как и у SearchServer.
+// Прочие исключения пробрасываются без публикации, и изменение не видно ни в одной копии.
+void ConcurrentSearchServer::Write(Update update) {
+    std::lock_guard guard(writer_mutex_);
+    const int hidden = 1 - published_.load();
+    for (const ReaderSlot& slot : readers_[hidden]) {
+        while (slot.count.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+    SynchronizeHidden(hidden);
+    // запись об изменении после публикации не должна выделять память
+    pending_updates_.reserve(1);
+
+    std::exception_ptr error;
+    try {
+        update(*servers_[hidden]);
+    }
+    catch (const std::invalid_argument&) {
+        error = std::current_exception();
+    }
+    catch (...) {
+        is_hidden_stale_ = true;
+        throw;
+    }
+    published_.store(hidden);
+    pending_updates_.push_back(std::move(update));
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+
+// Поисковый сервер, который можно опрашивать во время изменений (схема left-right).
+// Сервер хранится в двух копиях. Читатели берут снимок опубликованной копии и работают с ней
+// без блокировок; пишущий поток меняет вторую копию, публикует её и запоминает изменение, чтобы
+// повторить его на прежней копии, когда её покинет последний читатель. Чтение не ждёт никогда,
+// запись ждёт только читателей, взявших снимок до предыдущей публикации.
+//
+// Изменения выполняются по одному; вызовы из разных потоков сериализуются. Изменение, прерванное
+// исключением, отличным от std::invalid_argument, не публикуется; вторая копия тогда заново
+// копируется с опубликованной перед следующим изменением.
+class ConcurrentSearchServer {
+    // число счётчиков читателей на копию: потоки расходятся по разным строкам кэша
+    static constexpr size_t READER_SLOT_COUNT = 64;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<int> count{ 0 };
+    };
+
+    using ReaderSlots = std::array<ReaderSlot, READER_SLOT_COUNT>;
+
+public:
+    // Неизменяемый снимок сервера. Пока снимок жив, его копию сервера никто не меняет.
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other) noexcept;
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+
+        ~Snapshot();
+
+        const SearchServer& operator*() const {
+            return *server_;
+        }
+
+        const SearchServer* operator->() const {
+            return server_;
+        }
+
+    private:
+        friend class ConcurrentSearchServer;
+
+        Snapshot(const SearchServer* server, ReaderSlot* slot)
+            : server_(server)
+            , slot_(slot) {
+        }
+
+        const SearchServer* server_;
+        ReaderSlot* slot_;
+    };
+
+    template <typename StopWords>
+    explicit ConcurrentSearchServer(const StopWords& stop_words)
+        : servers_{ std::make_unique<SearchServer>(stop_words), std::make_unique<SearchServer>(stop_words) } {
+    }
+
+    Snapshot GetSnapshot() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    void Freeze();
+
+private:
+    using Update = std::function<void(SearchServer&)>;
+
+    // копии лежат в куче, чтобы неопубликованную можно было заменить копией опубликованной
+    std::unique_ptr<SearchServer> servers_[2];
+    mutable std::array<ReaderSlots, 2> readers_;
+    // номер опубликованной копии
+    std::atomic<int> published_{ 0 };
+
+    std::mutex writer_mutex_;
+    // изменения, уже применённые к опубликованной копии, но ещё не к другой
+    std::vector<Update> pending_updates_;
+    // неопубликованная копия частично изменена и должна быть скопирована с опубликованной
+    bool is_hidden_stale_ = false;
+
+    // Приводит неопубликованную копию к состоянию опубликованной
+    void SynchronizeHidden(int hidden);
+
+    void Write(Update update);
+};
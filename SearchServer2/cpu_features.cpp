@@ -0,0 +1,45 @@
+#include "cpu_features.h"
+
+#if SEARCH_SERVER_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static bool DetectSse2() {
+#if !SEARCH_SERVER_X86
+    return false;
+#elif defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool DetectAvx2() {
+#if !SEARCH_SERVER_X86
+    return false;
+#elif defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    const bool os_saves_ymm = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (!os_saves_ymm) {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool CpuSupportsSse2() {
+    static const bool supported = DetectSse2();
+    return supported;
+}
+
+bool CpuSupportsAvx2() {
+    static const bool supported = DetectAvx2();
+    return supported;
+}
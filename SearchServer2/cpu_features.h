@@ -0,0 +1,20 @@
+﻿#pragma once
+
+// Векторные расширения x86 доступны только при сборке под x86/x64
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SEARCH_SERVER_X86 1
+#else
+#define SEARCH_SERVER_X86 0
+#endif
+
+// Функции с векторным кодом для расширений, не включённых при сборке, помечаются этим атрибутом.
+// MSVC разрешает такие интринсики без дополнительных флагов.
+#if SEARCH_SERVER_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SEARCH_SERVER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SEARCH_SERVER_TARGET(isa)
+#endif
+
+// Результаты определяются один раз при первом обращении
+bool CpuSupportsSse2();
+bool CpuSupportsAvx2();
@@ -0,0 +1,131 @@
+﻿#include "durable_search_server.h"
+
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std::literals::string_literals;
+
+static constexpr char CHECKPOINT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'C', 'K', 'P', '\0' };
+
+// Файл снимка — этот заголовок и снимок сервера (SearchServer::SaveSnapshot)
+struct CheckpointHeader {
+    char magic[8];
+    // номер последней записи журнала, вошедшей в снимок
+    uint64_t sequence;
+};
+
+static std::string GetSnapshotPath(const std::string& directory) {
+    return (std::filesystem::path(directory) / "snapshot").string();
+}
+
+static std::string GetLogPath(const std::string& directory) {
+    return (std::filesystem::path(directory) / "wal").string();
+}
+
+DurableSearchServer::DurableSearchServer(const std::string& directory, SearchServer empty_server, WalDurability durability)
+    : directory_(directory)
+    , server_(LoadCheckpoint(directory, std::move(empty_server), checkpoint_sequence_))
+    , log_(GetLogPath(directory), WriteAheadLog::Replay(GetLogPath(directory), checkpoint_sequence_, server_) + 1, durability) {
+}
+
+SearchServer DurableSearchServer::LoadCheckpoint(const std::string& directory, SearchServer empty_server, uint64_t& sequence) {
+    std::filesystem::create_directories(directory);
+    const std::string path = GetSnapshotPath(directory);
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return empty_server;
+    }
+    CheckpointHeader header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a search server snapshot"s);
+    }
+    sequence = header.sequence;
+    return SearchServer::LoadSnapshot(input);
+}
+
+void DurableSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Write([&] {
+        return log_.AppendAddDocuments({ NewDocument{ document_id, document, status, ratings } });
+        }, [&] {
+            server_.AddDocument(document_id, document, status, ratings);
+        });
+}
+
+void DurableSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    Write([&] {
+        return log_.AppendAddDocuments(documents);
+        }, [&] {
+            server_.AddDocuments(documents);
+        });
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    Write([&] {
+        return log_.AppendRemoveDocuments({ document_id });
+        }, [&] {
+            server_.RemoveDocument(document_id);
+        });
+}
+
+void DurableSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    Write([&] {
+        return log_.AppendRemoveDocuments(document_ids);
+        }, [&] {
+            server_.RemoveDocuments(document_ids);
+        });
+}
+
+// Снимок становится действующим переименованием, поэтому сбой во время сохранения оставляет прежний снимок.
+// Сбой между переименованием и очисткой журнала безопасен: записи с номерами из снимка не повторяются.
+void DurableSearchServer::Checkpoint() {
+    std::lock_guard guard(mutex_);
+    const std::string path = GetSnapshotPath(directory_);
+    const std::string temporary_path = path + ".tmp"s;
+    {
+        std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            throw std::runtime_error("cannot create "s + temporary_path);
+        }
+        CheckpointHeader header{};
+        std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.sequence = log_.GetLastSequence();
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        server_.SaveSnapshot(output);
+    }
+    SyncPath(temporary_path);
+    std::filesystem::rename(temporary_path, path);
+    SyncPath(directory_);
+    log_.Truncate();
+}
+
+void DurableSearchServer::Sync() {
+    log_.Sync();
+}
+
+uint64_t DurableSearchServer::GetLastSequence() const {
+    return log_.GetLastSequence();
+}
+
+template <typename Append, typename Apply>
+void DurableSearchServer::Write(Append append, Apply apply) {
+    uint64_t sequence = 0;
+    std::exception_ptr error;
+    {
+        std::lock_guard guard(mutex_);
+        sequence = append();
+        try {
+            apply();
+        }
+        catch (const std::invalid_argument&) {
+            error = std::current_exception();
+        }
+    }
+    log_.WaitDurable(sequence);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// Поисковый сервер, переживающий перезапуск. Каждое изменение сначала дописывается в журнал
+// упреждающей записи, а Checkpoint сохраняет снимок сервера и очищает журнал. При создании сервер
+// загружает последний снимок из каталога и повторяет записи журнала после него, так что после сбоя
+// восстанавливается за время чтения снимка и хвоста журнала, без повторной загрузки документов.
+//
+// Изменения из разных потоков сериализуются, но fsync журнала ждут вне блокировки, поэтому
+// одновременные изменения фиксируются одним fsync. Читать сервер можно не одновременно с изменениями.
+class DurableSearchServer {
+public:
+    // Стоп-слова нужны только для пустого каталога; иначе они берутся из снимка
+    template <typename StopWords>
+    DurableSearchServer(const std::string& directory, const StopWords& stop_words,
+        WalDurability durability = WalDurability::PER_WRITE)
+        : DurableSearchServer(directory, SearchServer(stop_words), durability) {
+    }
+
+    // Исключение сервера (std::invalid_argument) бросается после того, как запись журнала стала надёжной
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Сохраняет снимок сервера (сначала во временный файл, который затем атомарно заменяет прежний снимок)
+    // и очищает журнал. Изменения на время сохранения приостанавливаются.
+    void Checkpoint();
+
+    // Сбрасывает журнал на диск независимо от режима
+    void Sync();
+
+    const SearchServer& GetServer() const {
+        return server_;
+    }
+
+    // Номер последней записи журнала; номера продолжаются после Checkpoint и перезапуска
+    uint64_t GetLastSequence() const;
+
+private:
+    std::string directory_;
+    // номер последней записи журнала, вошедшей в загруженный снимок
+    uint64_t checkpoint_sequence_ = 0;
+    SearchServer server_;
+    WriteAheadLog log_;
+    std::mutex mutex_;
+
+    DurableSearchServer(const std::string& directory, SearchServer empty_server, WalDurability durability);
+
+    // Загружает снимок каталога, если он есть, иначе возвращает empty_server
+    static SearchServer LoadCheckpoint(const std::string& directory, SearchServer empty_server, uint64_t& sequence);
+
+    // Дописывает изменение в журнал, применяет его к серверу и ждёт надёжности записи
+    template <typename Append, typename Apply>
+    void Write(Append append, Apply apply);
+};
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "column.h"
+
+// Набор битов, размер которого задаётся во время выполнения. Индексы — внутренние номера документов.
+// Одновременное чтение из нескольких потоков безопасно, запись требует внешней синхронизации.
+// Слова битов лежат в столбце, поэтому набор может читаться прямо из отображённого файла индекса.
+class DynamicBitset {
+public:
+    DynamicBitset() = default;
+
+    explicit DynamicBitset(size_t size)
+        : size_(size)
+        , words_((size + 63) / 64, 0) {
+    }
+
+    // Набор поверх готовых слов, например из файла индекса; words должен вмещать size битов
+    DynamicBitset(size_t size, Column<uint64_t> words)
+        : size_(size)
+        , words_(std::move(words)) {
+    }
+
+    const Column<uint64_t>& GetWords() const {
+        return words_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // Новые биты сброшены
+    void Resize(size_t size) {
+        if (size < size_ && size % 64 != 0) {
+            // хвост последнего слова обнуляется, чтобы при последующем росте не всплыли старые биты
+            words_.MutableData()[size / 64] &= (uint64_t(1) << (size % 64)) - 1;
+        }
+        size_ = size;
+        words_.Resize((size + 63) / 64, 0);
+    }
+
+    bool Test(size_t index) const {
+        return (words_[index / 64] >> (index % 64)) & 1;
+    }
+
+    void Set(size_t index) {
+        words_.MutableData()[index / 64] |= uint64_t(1) << (index % 64);
+    }
+
+    void Reset(size_t index) {
+        words_.MutableData()[index / 64] &= ~(uint64_t(1) << (index % 64));
+    }
+
+    // Число установленных битов с индексами из [first, last)
+    size_t Count(size_t first, size_t last) const {
+        last = last < size_ ? last : size_;
+        size_t count = 0;
+        for (size_t index = first; index < last;) {
+            if (index % 64 == 0 && index + 64 <= last) {
+                count += PopCount(words_[index / 64]);
+                index += 64;
+            }
+            else {
+                count += Test(index);
+                ++index;
+            }
+        }
+        return count;
+    }
+
+private:
+    size_t size_ = 0;
+    Column<uint64_t> words_;
+
+    static size_t PopCount(uint64_t word) {
+        word = word - ((word >> 1) & 0x5555555555555555ull);
+        word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+        word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return static_cast<size_t>((word * 0x0101010101010101ull) >> 56);
+    }
+};
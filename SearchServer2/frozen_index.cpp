@@ -0,0 +1,191 @@
+﻿#include "frozen_index.h"
+
+#include <algorithm>
+
+#include "index_file.h"
+
+using namespace std::literals::string_literals;
+
+static bool IsRemoved(const DynamicBitset& removed_documents, int document_id) {
+    return static_cast<size_t>(document_id) < removed_documents.Size() && removed_documents.Test(document_id);
+}
+
+FrozenIndex::FrozenIndex(const std::vector<std::map<int, double>>& word_to_document_freqs, const DynamicBitset& removed_documents) {
+    size_t posting_count = 0;
+    size_t block_count = 0;
+    for (const auto& document_freqs : word_to_document_freqs) {
+        posting_count += document_freqs.size();
+        block_count += (document_freqs.size() + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+    }
+    offsets_.Reserve(word_to_document_freqs.size() + 1);
+    block_offsets_.Reserve(word_to_document_freqs.size() + 1);
+    blocks_.Reserve(block_count);
+    block_max_term_freqs_.Reserve(block_count);
+    term_freqs_.Reserve(posting_count);
+    max_term_freqs_.Reserve(word_to_document_freqs.size());
+
+    offsets_.PushBack(0);
+    block_offsets_.PushBack(0);
+    std::vector<uint32_t> packed_document_ids;
+    for (const auto& document_freqs : word_to_document_freqs) {
+        AppendTerm(document_freqs.begin(), document_freqs.end(), removed_documents, packed_document_ids);
+    }
+    FinishBuild(std::move(packed_document_ids));
+}
+
+// Части покрывают непересекающиеся диапазоны id и идут по возрастанию, поэтому постинги терма
+// получаются простым дописыванием частей одна за другой
+FrozenIndex FrozenIndex::Merge(const std::vector<const FrozenIndex*>& parts, const DynamicBitset& removed_documents) {
+    size_t term_count = 0;
+    for (const FrozenIndex* part : parts) {
+        term_count = std::max(term_count, part->GetTermCount());
+    }
+    FrozenIndex result;
+    result.offsets_.PushBack(0);
+    result.block_offsets_.PushBack(0);
+    std::vector<std::pair<int, double>> postings;
+    std::vector<uint32_t> packed_document_ids;
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        postings.clear();
+        for (const FrozenIndex* part : parts) {
+            part->ForEachPosting(term_id, [&postings](int document_id, double term_freq) {
+                postings.emplace_back(document_id, term_freq);
+                });
+        }
+        result.AppendTerm(postings.begin(), postings.end(), removed_documents, packed_document_ids);
+    }
+    result.FinishBuild(std::move(packed_document_ids));
+    return result;
+}
+
+FrozenIndex FrozenIndex::WithoutDocuments(const DynamicBitset& removed_documents) const {
+    return Merge({ this }, removed_documents);
+}
+
+FrozenIndex FrozenIndex::Open(const IndexFile& file, int end_ordinal) {
+    FrozenIndex index;
+    index.offsets_ = file.GetColumn<uint64_t>(IndexSection::POSTING_OFFSETS);
+    index.block_offsets_ = file.GetColumn<uint64_t>(IndexSection::POSTING_BLOCK_OFFSETS);
+    index.blocks_ = file.GetColumn<PostingBlock>(IndexSection::POSTING_BLOCKS);
+    index.block_max_term_freqs_ = file.GetColumn<double>(IndexSection::POSTING_BLOCK_MAX_TERM_FREQS);
+    index.packed_document_ids_ = file.GetColumn<uint32_t>(IndexSection::POSTING_PACKED_DOCUMENT_IDS);
+    index.term_freqs_ = file.GetColumn<double>(IndexSection::POSTING_TERM_FREQS);
+    index.max_term_freqs_ = file.GetColumn<double>(IndexSection::POSTING_MAX_TERM_FREQS);
+    // границы термов — O(числа термов); сами блоки читаются только при обращении к терму
+    const size_t term_count = index.GetTermCount();
+    if (!AreValidOffsets(index.offsets_, index.term_freqs_.Size()) || !AreValidOffsets(index.block_offsets_, index.blocks_.Size())
+        || index.block_offsets_.Size() != index.offsets_.Size() || index.block_max_term_freqs_.Size() != index.blocks_.Size()
+        || index.max_term_freqs_.Size() != term_count) {
+        ThrowDamagedIndexFile("posting offsets"s);
+    }
+    index.checked_terms_.reset(new std::atomic<bool>[term_count]());
+    index.end_ordinal_ = end_ordinal;
+    return index;
+}
+
+// Блоки терма распаковываются один раз: дальше курсоры и ForEachPosting читают их без проверок.
+// Курсор находит tf постинга по номеру блока, поэтому неполным может быть только последний блок.
+void FrozenIndex::ValidateTerm(TermId term_id) const {
+    int document_ids[POSTING_BLOCK_SIZE];
+    uint64_t posting_count = 0;
+    int previous_document_id = -1;
+    const uint64_t end_block_index = block_offsets_[term_id + 1];
+    for (uint64_t block_index = block_offsets_[term_id]; block_index < end_block_index; ++block_index) {
+        const PostingBlock& block = blocks_[block_index];
+        // разности id неотрицательных int умещаются в 31 бит
+        if (block.size == 0 || block.size > POSTING_BLOCK_SIZE || block.bit_width > 31
+            || (block_index + 1 < end_block_index && block.size != POSTING_BLOCK_SIZE)
+            || static_cast<uint64_t>(block.data_offset) + (block.size * block.bit_width + 31) / 32 + 1 + POSTING_BLOCK_PADDING
+                > packed_document_ids_.Size()) {
+            ThrowDamagedIndexFile("posting blocks"s);
+        }
+        DecodePostingBlock(block, packed_document_ids_.Data(), document_ids);
+        for (size_t i = 0; i < block.size; ++i) {
+            if (document_ids[i] <= previous_document_id || document_ids[i] >= end_ordinal_) {
+                ThrowDamagedIndexFile("posting document ids"s);
+            }
+            previous_document_id = document_ids[i];
+        }
+        if (document_ids[0] != block.first_document_id || document_ids[block.size - 1] != block.last_document_id) {
+            ThrowDamagedIndexFile("posting blocks"s);
+        }
+        posting_count += block.size;
+    }
+    if (posting_count != offsets_[term_id + 1] - offsets_[term_id]) {
+        ThrowDamagedIndexFile("posting offsets"s);
+    }
+}
+
+void FrozenIndex::Save(IndexFileWriter& writer) const {
+    writer.WriteColumn(IndexSection::POSTING_OFFSETS, offsets_);
+    writer.WriteColumn(IndexSection::POSTING_BLOCK_OFFSETS, block_offsets_);
+    writer.WriteColumn(IndexSection::POSTING_BLOCKS, blocks_);
+    writer.WriteColumn(IndexSection::POSTING_BLOCK_MAX_TERM_FREQS, block_max_term_freqs_);
+    writer.WriteColumn(IndexSection::POSTING_PACKED_DOCUMENT_IDS, packed_document_ids_);
+    writer.WriteColumn(IndexSection::POSTING_TERM_FREQS, term_freqs_);
+    writer.WriteColumn(IndexSection::POSTING_MAX_TERM_FREQS, max_term_freqs_);
+}
+
+template <typename Iterator>
+void FrozenIndex::AppendTerm(Iterator first, Iterator last, const DynamicBitset& removed_documents,
+    std::vector<uint32_t>& packed_document_ids) {
+    int document_ids[POSTING_BLOCK_SIZE];
+    size_t block_size = 0;
+    double max_term_freq = 0.0;
+    double block_max_term_freq = 0.0;
+    const auto flush_block = [&]() {
+        blocks_.PushBack(EncodePostingBlock(document_ids, block_size, packed_document_ids));
+        block_max_term_freqs_.PushBack(block_max_term_freq);
+        block_size = 0;
+        block_max_term_freq = 0.0;
+    };
+    for (; first != last; ++first) {
+        if (IsRemoved(removed_documents, first->first)) {
+            continue;
+        }
+        const double term_freq = first->second;
+        max_term_freq = std::max(max_term_freq, term_freq);
+        block_max_term_freq = std::max(block_max_term_freq, term_freq);
+        document_ids[block_size++] = first->first;
+        term_freqs_.PushBack(term_freq);
+        if (block_size == POSTING_BLOCK_SIZE) {
+            flush_block();
+        }
+    }
+    if (block_size > 0) {
+        flush_block();
+    }
+    max_term_freqs_.PushBack(max_term_freq);
+    offsets_.PushBack(term_freqs_.Size());
+    block_offsets_.PushBack(blocks_.Size());
+}
+
+void FrozenIndex::FinishBuild(std::vector<uint32_t> packed_document_ids) {
+    packed_document_ids.resize(packed_document_ids.size() + POSTING_BLOCK_PADDING, 0);
+    packed_document_ids_ = Column<uint32_t>(std::move(packed_document_ids));
+}
+
+size_t FrozenIndex::GetDocumentCount(TermId term_id) const {
+    if (term_id >= GetTermCount()) {
+        return 0;
+    }
+    return static_cast<size_t>(offsets_[term_id + 1] - offsets_[term_id]);
+}
+
+FrozenIndex::TermPostings FrozenIndex::GetTermPostings(TermId term_id) const {
+    if (term_id >= GetTermCount()) {
+        return {};
+    }
+    if (checked_terms_ && !checked_terms_[term_id].load(std::memory_order_acquire)) {
+        ValidateTerm(term_id);
+        checked_terms_[term_id].store(true, std::memory_order_release);
+    }
+    return {
+        blocks_.Data() + block_offsets_[term_id],
+        block_max_term_freqs_.Data() + block_offsets_[term_id],
+        static_cast<size_t>(block_offsets_[term_id + 1] - block_offsets_[term_id]),
+        packed_document_ids_.Data(),
+        term_freqs_.Data() + offsets_[term_id],
+        max_term_freqs_[term_id],
+    };
+}
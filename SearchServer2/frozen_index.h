@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "column.h"
+#include "dynamic_bitset.h"
+#include "term_dictionary.h"
+#include "posting_codec.h"
+
+class IndexFile;
+class IndexFileWriter;
+
+// Неизменяемый обратный индекс в формате CSR: постинги всех термов лежат подряд, упорядоченные
+// по id документа, а offsets_ задаёт границы каждого терма. id документов сжаты блоками
+// (разности + упаковка битами, см. posting_codec.h), tf хранятся рядом в исходном виде,
+// чтобы релевантность совпадала с изменяемым индексом до бита. Массивы индекса — столбцы,
+// поэтому индекс, открытый из файла, читает постинги прямо из отображённых страниц.
+class FrozenIndex {
+public:
+    // Постинги одного терма: его блоки и tf, начиная с первого постинга терма.
+    // Для каждого блока известен максимальный tf, что позволяет оценивать вклад блока без распаковки.
+    struct TermPostings {
+        const PostingBlock* blocks = nullptr;
+        const double* block_max_term_freqs = nullptr;
+        size_t block_count = 0;
+        const uint32_t* packed_document_ids = nullptr;
+        const double* term_freqs = nullptr;
+        double max_term_freq = 0.0;
+    };
+
+    FrozenIndex() = default;
+
+    // Постинги документов, отмеченных в removed_documents, в индекс не попадают
+    explicit FrozenIndex(const std::vector<std::map<int, double>>& word_to_document_freqs,
+        const DynamicBitset& removed_documents = DynamicBitset());
+
+    // Объединяет индексы, покрывающие возрастающие непересекающиеся диапазоны id документов,
+    // отбрасывая постинги документов из removed_documents
+    static FrozenIndex Merge(const std::vector<const FrozenIndex*>& parts, const DynamicBitset& removed_documents);
+
+    // Копия индекса без постингов документов из removed_documents
+    FrozenIndex WithoutDocuments(const DynamicBitset& removed_documents) const;
+
+    // Постинги должны ссылаться на документы с ordinal меньше end_ordinal. При открытии проверяются
+    // только размеры секций и границы термов — O(числа термов), без чтения блоков. Блоки терма
+    // распаковываются и проверяются при первом обращении к его постингам: на повреждённом терме
+    // GetTermPostings и ForEachPosting бросают std::runtime_error.
+    // Бросает std::runtime_error, если размеры секций или границы термов не согласованы.
+    static FrozenIndex Open(const IndexFile& file, int end_ordinal);
+
+    void Save(IndexFileWriter& writer) const;
+
+    // Число документов, содержащих терм
+    size_t GetDocumentCount(TermId term_id) const;
+
+    size_t GetTermCount() const {
+        return offsets_.Empty() ? 0 : offsets_.Size() - 1;
+    }
+
+    TermPostings GetTermPostings(TermId term_id) const;
+
+    template <typename Callback>
+    void ForEachPosting(TermId term_id, Callback callback) const;
+
+private:
+    // постинги терма t — [offsets_[t], offsets_[t + 1]), его блоки — [block_offsets_[t], block_offsets_[t + 1])
+    Column<uint64_t> offsets_;
+    Column<uint64_t> block_offsets_;
+    Column<PostingBlock> blocks_;
+    Column<double> block_max_term_freqs_;
+    Column<uint32_t> packed_document_ids_;
+    Column<double> term_freqs_;
+    Column<double> max_term_freqs_;
+    // Только у индекса из файла: термы, блоки которых уже проверены. Копии индекса делят отметки,
+    // как и данные; гонка двух потоков за один терм безвредна — оба проверят одно и то же.
+    std::shared_ptr<std::atomic<bool>[]> checked_terms_;
+    int end_ordinal_ = 0;
+
+    // Дописывает постинги следующего терма: пары (id документа, tf) по возрастанию id.
+    // Упакованные id копятся в packed_document_ids до FinishBuild.
+    template <typename Iterator>
+    void AppendTerm(Iterator first, Iterator last, const DynamicBitset& removed_documents,
+        std::vector<uint32_t>& packed_document_ids);
+
+    void FinishBuild(std::vector<uint32_t> packed_document_ids);
+
+    void ValidateTerm(TermId term_id) const;
+};
+
+template <typename Callback>
+void FrozenIndex::ForEachPosting(TermId term_id, Callback callback) const {
+    const TermPostings postings = GetTermPostings(term_id);
+    int document_ids[POSTING_BLOCK_SIZE];
+    const double* term_freqs = postings.term_freqs;
+    for (size_t block_index = 0; block_index < postings.block_count; ++block_index) {
+        const PostingBlock& block = postings.blocks[block_index];
+        DecodePostingBlock(block, postings.packed_document_ids, document_ids);
+        for (size_t i = 0; i < block.size; ++i) {
+            callback(document_ids[i], term_freqs[i]);
+        }
+        term_freqs += block.size;
+    }
+}
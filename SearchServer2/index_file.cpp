@@ -0,0 +1,205 @@
+﻿#include "index_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "mapped_file.h"
+
+using namespace std::literals::string_literals;
+
+static constexpr char INDEX_FILE_MAGIC[8] = { 'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0' };
+static constexpr uint32_t INDEX_FILE_VERSION = 1;
+// записывается как число: на машине с другим порядком байт читается иначе
+static constexpr uint32_t INDEX_FILE_BYTE_ORDER = 0x01020304;
+static constexpr size_t INDEX_FILE_ALIGNMENT = 32;
+
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t reserved[2];
+};
+
+struct IndexSectionHeader {
+    uint32_t section;
+    uint32_t reserved;
+    uint64_t size;
+    uint64_t checksum;
+    uint64_t reserved2;
+};
+
+static_assert(sizeof(IndexFileHeader) == INDEX_FILE_ALIGNMENT && sizeof(IndexSectionHeader) == INDEX_FILE_ALIGNMENT);
+
+// Единица буфера, в который читается файл из потока: секции в нём выровнены так же, как в файле
+struct alignas(INDEX_FILE_ALIGNMENT) IndexFileBlock {
+    char bytes[INDEX_FILE_ALIGNMENT];
+};
+
+// Поток читается порциями: у оборванного или испорченного файла размер секции может быть любым,
+// и память под неё выделяется по мере чтения, а не заранее
+static constexpr size_t INDEX_FILE_READ_CHUNK = size_t(1) << 20;
+
+static uint64_t AlignSize(uint64_t size) {
+    return (size + INDEX_FILE_ALIGNMENT - 1) / INDEX_FILE_ALIGNMENT * INDEX_FILE_ALIGNMENT;
+}
+
+static void CheckHeader(const IndexFileHeader& header) {
+    if (std::memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("not an index file"s);
+    }
+    if (header.byte_order != INDEX_FILE_BYTE_ORDER) {
+        throw std::runtime_error("index file was written on a machine with another byte order"s);
+    }
+    if (header.version != INDEX_FILE_VERSION) {
+        throw std::runtime_error("unsupported index file version "s + std::to_string(header.version));
+    }
+}
+
+uint64_t ComputeChecksum(const void* data, size_t size, uint64_t checksum) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        checksum = (checksum ^ bytes[i]) * 1099511628211ull;
+    }
+    return checksum;
+}
+
+void ThrowDamagedIndexFile(const std::string& what) {
+    throw std::runtime_error("index file is damaged: "s + what);
+}
+
+bool AreValidOffsets(const Column<uint64_t>& offsets, uint64_t value_count) {
+    if (offsets.Empty()) {
+        return true;
+    }
+    if (offsets[0] != 0 || offsets[offsets.Size() - 1] > value_count) {
+        return false;
+    }
+    return std::is_sorted(offsets.begin(), offsets.end());
+}
+
+bool AreValidOffsetEndpoints(const Column<uint64_t>& offsets, uint64_t value_count) {
+    return offsets.Empty() || (offsets[0] == 0 && offsets[offsets.Size() - 1] <= value_count);
+}
+
+IndexFileWriter::IndexFileWriter(std::ostream& output)
+    : output_(output) {
+    IndexFileHeader header{};
+    std::memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+    header.version = INDEX_FILE_VERSION;
+    header.byte_order = INDEX_FILE_BYTE_ORDER;
+    Write(&header, sizeof(header));
+}
+
+void IndexFileWriter::WriteSection(IndexSection section, const void* data, size_t size) {
+    IndexSectionHeader header{};
+    header.section = static_cast<uint32_t>(section);
+    header.size = size;
+    header.checksum = ComputeChecksum(data, size);
+    Write(&header, sizeof(header));
+    Write(data, size);
+    static const char padding[INDEX_FILE_ALIGNMENT] = {};
+    Write(padding, static_cast<size_t>(AlignSize(offset_) - offset_));
+}
+
+void IndexFileWriter::Finish() {
+    WriteSection(IndexSection::END, nullptr, 0);
+    output_.flush();
+    if (!output_) {
+        throw std::runtime_error("cannot write index file"s);
+    }
+}
+
+void IndexFileWriter::Write(const void* data, size_t size) {
+    output_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    offset_ += size;
+}
+
+IndexFile::IndexFile(const char* data, size_t size, std::shared_ptr<const void> owner)
+    : owner_(std::move(owner)) {
+    IndexFileHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("not an index file"s);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    CheckHeader(header);
+    uint64_t offset = sizeof(header);
+    while (true) {
+        IndexSectionHeader section_header;
+        if (size - offset < sizeof(section_header)) {
+            throw std::runtime_error("index file is truncated"s);
+        }
+        std::memcpy(&section_header, data + offset, sizeof(section_header));
+        offset += sizeof(section_header);
+        if (size - offset < section_header.size) {
+            throw std::runtime_error("index file is truncated"s);
+        }
+        const auto section = static_cast<IndexSection>(section_header.section);
+        if (section == IndexSection::END) {
+            break;
+        }
+        sections_[section] = { data + offset, section_header.size, section_header.checksum };
+        offset = std::min<uint64_t>(size, AlignSize(offset + section_header.size));
+    }
+}
+
+IndexFile IndexFile::Map(const std::string& path) {
+    const std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+    return IndexFile(file->Data(), file->Size(), file);
+}
+
+IndexFile IndexFile::Read(std::istream& input) {
+    auto buffer = std::make_shared<std::vector<IndexFileBlock>>();
+    uint64_t size = 0;
+    const auto read = [&](uint64_t count) {
+        while (count > 0) {
+            const size_t chunk = static_cast<size_t>(std::min<uint64_t>(count, INDEX_FILE_READ_CHUNK));
+            buffer->resize(static_cast<size_t>(AlignSize(size + chunk) / INDEX_FILE_ALIGNMENT));
+            input.read(reinterpret_cast<char*>(buffer->data()) + size, static_cast<std::streamsize>(chunk));
+            if (input.gcount() != static_cast<std::streamsize>(chunk)) {
+                throw std::runtime_error("index file is truncated"s);
+            }
+            size += chunk;
+            count -= chunk;
+        }
+        return reinterpret_cast<const char*>(buffer->data()) + size;
+    };
+
+    IndexFileHeader header;
+    std::memcpy(&header, read(sizeof(header)) - sizeof(header), sizeof(header));
+    CheckHeader(header);
+    while (true) {
+        IndexSectionHeader section_header;
+        std::memcpy(&section_header, read(sizeof(section_header)) - sizeof(section_header), sizeof(section_header));
+        if (static_cast<IndexSection>(section_header.section) == IndexSection::END) {
+            break;
+        }
+        // данные секции вместе с выравниванием до следующего заголовка
+        read(AlignSize(section_header.size));
+    }
+
+    const char* data = reinterpret_cast<const char*>(buffer->data());
+    IndexFile file(data, static_cast<size_t>(size), std::move(buffer));
+    file.VerifyChecksums();
+    return file;
+}
+
+void IndexFile::VerifyChecksums() const {
+    for (const auto& [section, data] : sections_) {
+        if (ComputeChecksum(data.data, static_cast<size_t>(data.size)) != data.checksum) {
+            throw std::runtime_error("index file section "s + std::to_string(static_cast<uint32_t>(section)) + " is damaged"s);
+        }
+    }
+}
+
+bool IndexFile::HasSection(IndexSection section) const {
+    return sections_.count(section) > 0;
+}
+
+const IndexFile::Section& IndexFile::GetSection(IndexSection section) const {
+    const auto it = sections_.find(section);
+    if (it == sections_.end()) {
+        throw std::runtime_error("index file has no section "s + std::to_string(static_cast<uint32_t>(section)));
+    }
+    return it->second;
+}
@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "column.h"
+
+// Формат файла индекса. Файл — заголовок (сигнатура, версия формата, отметка порядка байт)
+// и последовательность секций, завершённая секцией END. Каждая секция — заголовок (номер секции,
+// размер, контрольная сумма FNV-1a) и массив значений фиксированной ширины в порядке байт машины.
+// Заголовки и начала секций выровнены по 32 байтам, поэтому отображённый в память файл читается
+// на месте: столбцы сервера ссылаются прямо на данные секций.
+enum class IndexSection : uint32_t {
+    END = 0,
+    STOP_WORD_OFFSETS = 1,
+    STOP_WORD_CHARS = 2,
+    TERM_WORD_OFFSETS = 10,
+    TERM_WORD_CHARS = 11,
+    TERM_HASH_SLOTS = 12,
+    TERM_DOCUMENT_COUNTS = 13,
+    DOCUMENT_IDS = 20,
+    DOCUMENT_ID_ORDINALS = 21,
+    ORDINAL_DOCUMENT_IDS = 22,
+    RATINGS = 23,
+    STATUSES = 24,
+    // битовые карты статусов: STATUS_DOCUMENTS + номер статуса
+    STATUS_DOCUMENTS = 25,
+    TEXT_OFFSETS = 30,
+    TEXT_CHARS = 31,
+    FORWARD_OFFSETS = 32,
+    FORWARD_TERM_FREQS = 33,
+    POSTING_OFFSETS = 40,
+    POSTING_BLOCK_OFFSETS = 41,
+    POSTING_BLOCKS = 42,
+    POSTING_BLOCK_MAX_TERM_FREQS = 43,
+    POSTING_PACKED_DOCUMENT_IDS = 44,
+    POSTING_TERM_FREQS = 45,
+    POSTING_MAX_TERM_FREQS = 46,
+};
+
+// FNV-1a, 64 бита
+uint64_t ComputeChecksum(const void* data, size_t size, uint64_t checksum = 14695981039346656037ull);
+
+// Контрольная сумма не защищает от файла, записанного с ошибкой или подделанного с пересчётом сумм,
+// поэтому содержимое секций, по которому вычисляются адреса, проверяется до его использования: размеры
+// секций и границы — при открытии, строки документов и постинги термов — при первом чтении.
+// Бросает std::runtime_error о повреждённой части what файла индекса.
+[[noreturn]] void ThrowDamagedIndexFile(const std::string& what);
+
+// Границы строк CSR: пустой столбец или неубывающие значения от 0 до не больше value_count
+bool AreValidOffsets(const Column<uint64_t>& offsets, uint64_t value_count);
+
+// Только крайние границы строк CSR, за O(1): границы отдельных строк проверяет RaggedColumn::GetRow
+bool AreValidOffsetEndpoints(const Column<uint64_t>& offsets, uint64_t value_count);
+
+// Пишет файл индекса последовательно, без перемещений по потоку
+class IndexFileWriter {
+public:
+    explicit IndexFileWriter(std::ostream& output);
+
+    void WriteSection(IndexSection section, const void* data, size_t size);
+
+    template <typename T>
+    void WriteColumn(IndexSection section, const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "index file stores only trivially copyable values");
+        WriteSection(section, values, count * sizeof(T));
+    }
+
+    template <typename T>
+    void WriteColumn(IndexSection section, const Column<T>& values) {
+        WriteColumn(section, values.Data(), values.Size());
+    }
+
+    // Дописывает секцию END; бросает std::runtime_error, если запись не удалась
+    void Finish();
+
+private:
+    std::ostream& output_;
+    uint64_t offset_ = 0;
+
+    void Write(const void* data, size_t size);
+};
+
+// Секции файла индекса, лежащего в памяти целиком. Содержимое секций при разборе не читается.
+class IndexFile {
+public:
+    // data должен быть выровнен по 32 байтам; owner продлевает жизнь памяти.
+    // Бросает std::runtime_error, если это не файл индекса или версия формата не поддерживается.
+    IndexFile(const char* data, size_t size, std::shared_ptr<const void> owner);
+
+    // Отображает файл в память без чтения его содержимого
+    static IndexFile Map(const std::string& path);
+
+    // Читает файл индекса из потока до секции END в один выровненный буфер и проверяет контрольные суммы.
+    // Бросает std::runtime_error, если поток обрывается или данные повреждены.
+    static IndexFile Read(std::istream& input);
+
+    // Бросает std::runtime_error, если контрольная сумма какой-либо секции не сходится
+    void VerifyChecksums() const;
+
+    bool HasSection(IndexSection section) const;
+
+    // Столбец поверх данных секции; бросает std::runtime_error, если секции нет
+    template <typename T>
+    Column<T> GetColumn(IndexSection section) const {
+        static_assert(std::is_trivially_copyable_v<T>, "index file stores only trivially copyable values");
+        const Section& data = GetSection(section);
+        if (data.size % sizeof(T) != 0) {
+            using namespace std::literals::string_literals;
+            throw std::runtime_error("index file section "s + std::to_string(static_cast<uint32_t>(section)) + " is damaged"s);
+        }
+        return Column<T>(reinterpret_cast<const T*>(data.data), static_cast<size_t>(data.size / sizeof(T)), owner_);
+    }
+
+private:
+    struct Section {
+        const char* data = nullptr;
+        uint64_t size = 0;
+        uint64_t checksum = 0;
+    };
+
+    std::map<IndexSection, Section> sections_;
+    std::shared_ptr<const void> owner_;
+
+    const Section& GetSection(IndexSection section) const;
+};
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Таблица IDF термов, помеченная поколением индекса, для которого она посчитана.
+// Пересчитывается лениво при первом обращении после изменения индекса, поэтому серия изменений
+// стоит одного пересчёта. Читать можно из нескольких потоков: пересчёт выполняет один из них.
+class InverseDocumentFreqCache {
+public:
+    InverseDocumentFreqCache() = default;
+
+    // Таблица не копируется: копия пересчитает её при первом обращении
+    InverseDocumentFreqCache(const InverseDocumentFreqCache&) {
+    }
+
+    InverseDocumentFreqCache& operator=(const InverseDocumentFreqCache&) {
+        generation_.store(NO_GENERATION, std::memory_order_relaxed);
+        return *this;
+    }
+
+    // Возвращает таблицу для поколения generation; при несовпадении поколений заполняет её вызовом refresh(table)
+    template <typename Refresh>
+    const std::vector<double>& Get(uint64_t generation, Refresh refresh) {
+        if (generation_.load(std::memory_order_acquire) != generation) {
+            std::lock_guard guard(mutex_);
+            if (generation_.load(std::memory_order_relaxed) != generation) {
+                refresh(table_);
+                generation_.store(generation, std::memory_order_release);
+            }
+        }
+        return table_;
+    }
+
+private:
+    static constexpr uint64_t NO_GENERATION = UINT64_MAX;
+
+    std::atomic<uint64_t> generation_{ NO_GENERATION };
+    std::mutex mutex_;
+    std::vector<double> table_;
+};
@@ -79,8 +79,14 @@
 using namespace std::literals::string_literals;
 using namespace std;
 
-int main() {
-	
+int main(int argc, char* argv[]) {
+#ifndef _WIN32
+	//  ,  StartShardProcess
+	if (const int exit_code = RunShardProcess(argc, argv); exit_code >= 0) {
+		return exit_code;
+	}
+#endif
+
 	TestSearchServerStrings();
 
 	benchmark_MatchDocument();
@@ -0,0 +1,89 @@
+﻿#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals::string_literals;
+
+#ifdef _WIN32
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->file_ == INVALID_HANDLE_VALUE) {
+        file->file_ = nullptr;
+        throw std::runtime_error("cannot open "s + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file_, &size)) {
+        throw std::runtime_error("cannot read size of "s + path);
+    }
+    file->size_ = static_cast<size_t>(size.QuadPart);
+    if (file->size_ == 0) {
+        return file;
+    }
+    file->mapping_ = CreateFileMappingA(file->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file->mapping_ == nullptr) {
+        throw std::runtime_error("cannot map "s + path);
+    }
+    file->data_ = static_cast<const char*>(MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (file->data_ == nullptr) {
+        throw std::runtime_error("cannot map "s + path);
+    }
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    if (file_ != nullptr) {
+        CloseHandle(file_);
+    }
+}
+
+#else
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open "s + path);
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot read size of "s + path);
+    }
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->size_ = static_cast<size_t>(status.st_size);
+    if (file->size_ > 0) {
+        void* data = mmap(nullptr, file->size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("cannot map "s + path);
+        }
+        file->data_ = static_cast<const char*>(data);
+    }
+    // отображение остаётся действительным и после закрытия дескриптора
+    close(fd);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#endif
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Файл, отображённый в память только для чтения. Страницы подгружаются системой при первом обращении,
+// поэтому открытие не зависит от размера файла.
+class MappedFile {
+public:
+    // Бросает std::runtime_error, если файл не удаётся открыть или отобразить
+    static std::shared_ptr<const MappedFile> Open(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* Data() const {
+        return data_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    MappedFile() = default;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
@@ -0,0 +1,146 @@
+﻿#include "posting_codec.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+
+#if SEARCH_SERVER_X86
+#include <immintrin.h>
+#endif
+
+static uint8_t ComputeBitWidth(uint32_t value) {
+    uint8_t width = 0;
+    while (value != 0) {
+        ++width;
+        value >>= 1;
+    }
+    return width;
+}
+
+PostingBlock EncodePostingBlock(const int* document_ids, size_t count, std::vector<uint32_t>& data) {
+    PostingBlock block;
+    block.first_document_id = document_ids[0];
+    block.last_document_id = document_ids[count - 1];
+    block.data_offset = static_cast<uint32_t>(data.size());
+    block.size = static_cast<uint8_t>(count);
+
+    uint32_t max_delta = 0;
+    for (size_t i = 1; i < count; ++i) {
+        max_delta = std::max(max_delta, static_cast<uint32_t>(document_ids[i] - document_ids[i - 1]));
+    }
+    block.bit_width = ComputeBitWidth(max_delta);
+
+    // лишнее слово в конце позволяет распаковщику всегда читать пару соседних слов
+    const size_t word_count = (count * block.bit_width + 31) / 32 + 1;
+    data.resize(data.size() + word_count, 0);
+    uint32_t* words = data.data() + block.data_offset;
+
+    // разность для первого id всегда 0: он хранится в заголовке блока
+    for (size_t i = 1; i < count; ++i) {
+        const uint32_t delta = static_cast<uint32_t>(document_ids[i] - document_ids[i - 1]);
+        const size_t position = i * block.bit_width;
+        const size_t shift = position & 31;
+        words[position >> 5] |= delta << shift;
+        if (shift + block.bit_width > 32) {
+            words[(position >> 5) + 1] |= delta >> (32 - shift);
+        }
+    }
+    return block;
+}
+
+static void UnpackScalar(const uint32_t* words, uint8_t bit_width, size_t count, uint32_t* deltas) {
+    const uint64_t mask = (uint64_t{ 1 } << bit_width) - 1;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t position = i * bit_width;
+        const size_t index = position >> 5;
+        const uint64_t pair = words[index] | (static_cast<uint64_t>(words[index + 1]) << 32);
+        deltas[i] = static_cast<uint32_t>((pair >> (position & 31)) & mask);
+    }
+}
+
+static void PrefixSumScalar(const uint32_t* deltas, size_t count, int first_document_id, int* document_ids) {
+    uint32_t current = static_cast<uint32_t>(first_document_id);
+    for (size_t i = 0; i < count; ++i) {
+        current += deltas[i];
+        document_ids[i] = static_cast<int>(current);
+    }
+}
+
+#if SEARCH_SERVER_X86
+
+// Распаковка по 8 значений: каждое значение собирается из пары соседних слов через gather и сдвиги
+SEARCH_SERVER_TARGET("avx2")
+static void UnpackAvx2(const uint32_t* words, uint8_t bit_width, size_t count, uint32_t* deltas) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i width = _mm256_set1_epi32(bit_width);
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>((uint32_t{ 1 } << bit_width) - 1));
+    const __m256i low_bits = _mm256_set1_epi32(31);
+    const __m256i word_bits = _mm256_set1_epi32(32);
+    const __m256i one = _mm256_set1_epi32(1);
+    const int* base = reinterpret_cast<const int*>(words);
+    for (size_t i = 0; i < count; i += 8) {
+        const __m256i position = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lanes), width);
+        const __m256i index = _mm256_srli_epi32(position, 5);
+        const __m256i shift = _mm256_and_si256(position, low_bits);
+        const __m256i low = _mm256_i32gather_epi32(base, index, 4);
+        const __m256i high = _mm256_i32gather_epi32(base, _mm256_add_epi32(index, one), 4);
+        // сдвиг влево на 32 в AVX2 даёт 0, поэтому случай shift == 0 отдельно не обрабатывается
+        const __m256i value = _mm256_or_si256(_mm256_srlv_epi32(low, shift), _mm256_sllv_epi32(high, _mm256_sub_epi32(word_bits, shift)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(deltas + i), _mm256_and_si256(value, mask));
+    }
+}
+
+// Префиксная сумма по 4 значения с переносом последнего элемента в следующую четвёрку.
+// Читаются только первые count разностей: неполная четвёрка в конце досчитывается скалярно.
+SEARCH_SERVER_TARGET("sse2")
+static void PrefixSumSse2(const uint32_t* deltas, size_t count, int first_document_id, int* document_ids) {
+    __m128i carry = _mm_set1_epi32(first_document_id);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i));
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+        value = _mm_add_epi32(value, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(document_ids + i), value);
+        carry = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    PrefixSumScalar(deltas + i, count - i, _mm_cvtsi128_si32(carry), document_ids + i);
+}
+
+#endif
+
+static PostingDecoder ResolveDecoder(PostingDecoder decoder) {
+    if (decoder == PostingDecoder::AUTO) {
+        decoder = PostingDecoder::AVX2;
+    }
+    if (decoder == PostingDecoder::AVX2 && !CpuSupportsAvx2()) {
+        decoder = PostingDecoder::SSE2;
+    }
+    if (decoder == PostingDecoder::SSE2 && !CpuSupportsSse2()) {
+        decoder = PostingDecoder::SCALAR;
+    }
+    return decoder;
+}
+
+void DecodePostingBlock(const PostingBlock& block, const uint32_t* data, int* document_ids, PostingDecoder decoder) {
+    const uint32_t* words = data + block.data_offset;
+    const size_t count = block.size;
+    // векторные варианты пишут до кратного 8 числа элементов, поэтому буфер полного размера
+    uint32_t deltas[POSTING_BLOCK_SIZE];
+
+    switch (ResolveDecoder(decoder)) {
+#if SEARCH_SERVER_X86
+    case PostingDecoder::AVX2:
+        UnpackAvx2(words, block.bit_width, count, deltas);
+        PrefixSumSse2(deltas, count, block.first_document_id, document_ids);
+        return;
+    case PostingDecoder::SSE2:
+        UnpackScalar(words, block.bit_width, count, deltas);
+        PrefixSumSse2(deltas, count, block.first_document_id, document_ids);
+        return;
+#endif
+    default:
+        UnpackScalar(words, block.bit_width, count, deltas);
+        PrefixSumScalar(deltas, count, block.first_document_id, document_ids);
+        return;
+    }
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Постинги хранятся блоками по POSTING_BLOCK_SIZE id документов. Внутри блока хранятся разности
+// соседних id, упакованные фиксированным для блока числом бит.
+constexpr size_t POSTING_BLOCK_SIZE = 128;
+
+// Запас слов в конце упакованных данных: векторная распаковка читает немного дальше конца блока
+constexpr size_t POSTING_BLOCK_PADDING = 8;
+
+struct PostingBlock {
+    int first_document_id = 0;
+    int last_document_id = 0;
+    uint32_t data_offset = 0;  // смещение в словах uint32_t от начала упакованных данных
+    uint8_t bit_width = 0;
+    uint8_t size = 0;
+    // явное выравнивание: блоки записываются в файл индекса как есть, без мусора в промежутках
+    uint16_t reserved = 0;
+};
+
+enum class PostingDecoder {
+    AUTO,
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Кодирует до POSTING_BLOCK_SIZE строго возрастающих id и дописывает упакованные слова в data
+PostingBlock EncodePostingBlock(const int* document_ids, size_t count, std::vector<uint32_t>& data);
+
+// Записывает в document_ids ровно block.size id документов; буфер должен вмещать POSTING_BLOCK_SIZE элементов.
+// Неподдерживаемый процессором декодер заменяется скалярным.
+void DecodePostingBlock(const PostingBlock& block, const uint32_t* data, int* document_ids,
+    PostingDecoder decoder = PostingDecoder::AUTO);
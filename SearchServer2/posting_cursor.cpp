@@ -0,0 +1,106 @@
+﻿#include "posting_cursor.h"
+
+#include <algorithm>
+
+PostingCursor::PostingCursor(const std::map<int, double>& postings, double max_term_freq)
+    : it_(postings.begin())
+    , end_(postings.end())
+    , postings_(&postings)
+    , max_term_freq_(max_term_freq) {
+    document_ = it_ == end_ ? END : it_->first;
+}
+
+PostingCursor::PostingCursor(const FrozenIndex::TermPostings& postings)
+    : is_frozen_(true)
+    , frozen_(postings) {
+    LoadBlock(0);
+}
+
+double PostingCursor::GetTermFreq() const {
+    if (is_frozen_) {
+        // все блоки терма, кроме последнего, заполнены полностью
+        return frozen_.term_freqs[block_index_ * POSTING_BLOCK_SIZE + position_];
+    }
+    return it_->second;
+}
+
+void PostingCursor::Next() {
+    if (document_ == END) {
+        return;
+    }
+    if (!is_frozen_) {
+        ++it_;
+        document_ = it_ == end_ ? END : it_->first;
+        return;
+    }
+    if (++position_ < frozen_.blocks[block_index_].size) {
+        document_ = block_documents_[position_];
+        return;
+    }
+    LoadBlock(block_index_ + 1);
+}
+
+void PostingCursor::Advance(int target) {
+    if (document_ >= target) {
+        return;
+    }
+    if (!is_frozen_) {
+        it_ = postings_->lower_bound(target);
+        document_ = it_ == end_ ? END : it_->first;
+        return;
+    }
+    // блоки, целиком лежащие левее target, пропускаются по заголовкам без распаковки
+    const size_t block_index = FindBlock(block_index_, target);
+    if (block_index != block_index_) {
+        LoadBlock(block_index);
+        if (document_ == END) {
+            return;
+        }
+    }
+    const int* first = block_documents_ + position_;
+    const int* last = block_documents_ + frozen_.blocks[block_index_].size;
+    const int* found = std::lower_bound(first, last, target);
+    position_ = found - block_documents_;
+    document_ = *found;
+}
+
+PostingCursor::BlockBound PostingCursor::GetBlockBound(int target) {
+    if (!is_frozen_) {
+        return { max_term_freq_, END };
+    }
+    bound_block_index_ = FindBlock(std::max(bound_block_index_, block_index_), target);
+    if (bound_block_index_ >= frozen_.block_count) {
+        return { 0.0, END };
+    }
+    return { frozen_.block_max_term_freqs[bound_block_index_], frozen_.blocks[bound_block_index_].last_document_id };
+}
+
+// Первый блок, начиная с from, чей последний документ не меньше target
+size_t PostingCursor::FindBlock(size_t from, int target) const {
+    const PostingBlock* blocks = frozen_.blocks;
+    const size_t count = frozen_.block_count;
+    if (from >= count || blocks[from].last_document_id >= target) {
+        return from;
+    }
+    // шаги 1, 2, 4, ... до блока, заходящего за target, затем двоичный поиск внутри шага
+    size_t step = 1;
+    while (from + step < count && blocks[from + step].last_document_id < target) {
+        step *= 2;
+    }
+    const PostingBlock* first = blocks + from + step / 2 + 1;
+    const PostingBlock* last = blocks + std::min(from + step, count);
+    return std::lower_bound(first, last, target, [](const PostingBlock& block, int document) {
+        return block.last_document_id < document;
+        }) - blocks;
+}
+
+void PostingCursor::LoadBlock(size_t block_index) {
+    block_index_ = block_index;
+    position_ = 0;
+    if (block_index >= frozen_.block_count) {
+        document_ = END;
+        return;
+    }
+    DecodePostingBlock(frozen_.blocks[block_index], frozen_.packed_document_ids, block_documents_);
+    document_ = block_documents_[0];
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <climits>
+#include <map>
+
+#include "frozen_index.h"
+
+// Курсор по постингам одного терма в порядке возрастания внутреннего id документа.
+// Работает как с изменяемым индексом (std::map), так и со сжатыми блоками FrozenIndex.
+class PostingCursor {
+public:
+    static constexpr int END = INT_MAX;
+
+    // Оценка блока постингов: максимальный tf в блоке и последний документ блока
+    struct BlockBound {
+        double max_term_freq;
+        int last_document;
+    };
+
+    // max_term_freq — верхняя граница tf терма; изменяемый индекс рассматривается как один блок
+    PostingCursor(const std::map<int, double>& postings, double max_term_freq);
+
+    explicit PostingCursor(const FrozenIndex::TermPostings& postings);
+
+    // Текущий документ или END, если постинги закончились
+    int GetDocument() const {
+        return document_;
+    }
+
+    double GetTermFreq() const;
+
+    void Next();
+
+    // Переходит к первому постингу с документом не меньше target.
+    // Блоки сжатого индекса пропускаются галопирующим поиском по заголовкам.
+    void Advance(int target);
+
+    // Оценка блока, в котором мог бы лежать target (target не меньше текущего документа).
+    // Курсор не сдвигается и блок не распаковывается.
+    BlockBound GetBlockBound(int target);
+
+private:
+    int document_ = END;
+    bool is_frozen_ = false;
+
+    std::map<int, double>::const_iterator it_;
+    std::map<int, double>::const_iterator end_;
+    const std::map<int, double>* postings_ = nullptr;
+    double max_term_freq_ = 0.0;
+
+    FrozenIndex::TermPostings frozen_;
+    size_t block_index_ = 0;
+    size_t position_ = 0;
+    size_t bound_block_index_ = 0;
+    int block_documents_[POSTING_BLOCK_SIZE];
+
+    void LoadBlock(size_t block_index);
+
+    size_t FindBlock(size_t from, int target) const;
+};
@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Ограниченный кеш значений по тексту запроса с вытеснением давно не использованных (LRU).
+// Записи помечены поколением индекса: при обращении с другим поколением часть кеша очищается.
+// Ключи разбиты по частям со своими блокировками, поэтому потоки с разными запросами почти
+// не мешают друг другу; значения отдаются через shared_ptr и копируются только указателем.
+template <typename Value>
+class QueryCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+    explicit QueryCache(size_t capacity = DEFAULT_CAPACITY)
+        : buckets_(BUCKET_COUNT) {
+        SetCapacity(capacity);
+    }
+
+    // Записи не копируются: копия наполнит кеш заново
+    QueryCache(const QueryCache& other)
+        : QueryCache(other.GetCapacity()) {
+    }
+
+    QueryCache& operator=(const QueryCache& other) {
+        SetCapacity(other.GetCapacity());
+        return *this;
+    }
+
+    // Ёмкость делится между частями поровну; 0 отключает кеш. Записи сбрасываются.
+    // Вызывается не одновременно с Get.
+    void SetCapacity(size_t capacity) {
+        for (Bucket& bucket : buckets_) {
+            std::lock_guard guard(bucket.mutex);
+            bucket.capacity = (capacity + BUCKET_COUNT - 1) / BUCKET_COUNT;
+            bucket.generation = NO_GENERATION;
+            bucket.entries.clear();
+            bucket.positions.clear();
+        }
+        capacity_ = capacity;
+    }
+
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    // Возвращает значение запроса для поколения generation, при промахе вычисляя его вызовом build(query).
+    // build выполняется вне блокировки; если он бросает исключение, в кеше ничего не остаётся.
+    template <typename Build>
+    std::shared_ptr<const Value> Get(std::string_view query, uint64_t generation, Build build) {
+        if (capacity_ == 0) {
+            return std::make_shared<const Value>(build(query));
+        }
+        Bucket& bucket = buckets_[std::hash<std::string_view>{}(query) % BUCKET_COUNT];
+        {
+            std::lock_guard guard(bucket.mutex);
+            bucket.Synchronize(generation);
+            if (const auto it = bucket.positions.find(query); it != bucket.positions.end()) {
+                bucket.entries.splice(bucket.entries.begin(), bucket.entries, it->second);
+                return it->second->value;
+            }
+        }
+
+        auto value = std::make_shared<const Value>(build(query));
+
+        std::lock_guard guard(bucket.mutex);
+        bucket.Synchronize(generation);
+        if (bucket.positions.count(query) > 0) {
+            // пока значение строилось, запрос добавил другой поток
+            return value;
+        }
+        bucket.entries.push_front({ std::string(query), value });
+        bucket.positions.emplace(bucket.entries.front().query, bucket.entries.begin());
+        if (bucket.entries.size() > bucket.capacity) {
+            bucket.positions.erase(bucket.entries.back().query);
+            bucket.entries.pop_back();
+        }
+        return value;
+    }
+
+private:
+    static constexpr size_t BUCKET_COUNT = 16;
+    static constexpr uint64_t NO_GENERATION = UINT64_MAX;
+
+    struct Entry {
+        std::string query;
+        std::shared_ptr<const Value> value;
+    };
+
+    struct Bucket {
+        std::mutex mutex;
+        size_t capacity = 0;
+        uint64_t generation = NO_GENERATION;
+        // от недавно использованных к давно не использованным
+        std::list<Entry> entries;
+        // ключи указывают на строки в entries, которые не перемещаются
+        std::unordered_map<std::string_view, typename std::list<Entry>::iterator> positions;
+
+        // Записи другого поколения недействительны
+        void Synchronize(uint64_t current_generation) {
+            if (generation != current_generation) {
+                entries.clear();
+                positions.clear();
+                generation = current_generation;
+            }
+        }
+    };
+
+    std::vector<Bucket> buckets_;
+    size_t capacity_ = 0;
+};
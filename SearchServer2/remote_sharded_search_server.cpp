@@ -0,0 +1,214 @@
+﻿#include "remote_sharded_search_server.h"
+
+#ifndef _WIN32
+
+#include <cmath>
+#include <exception>
+#include <map>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "shard_process.h"
+#include "sharded_search_server.h"
+#include "top_k.h"
+
+using namespace std::literals::string_literals;
+
+RemoteShardedSearchServer::RemoteShardedSearchServer(std::vector<std::string> socket_paths, std::chrono::milliseconds timeout)
+    : timeout_(timeout) {
+    if (socket_paths.empty()) {
+        throw std::invalid_argument("shard count must be positive"s);
+    }
+    for (std::string& socket_path : socket_paths) {
+        shards_.push_back({ std::move(socket_path) });
+    }
+}
+
+RemoteShardedSearchServer::~RemoteShardedSearchServer() {
+    for (Shard& shard : shards_) {
+        Disconnect(shard);
+    }
+}
+
+size_t RemoteShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+void RemoteShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    MessageWriter request;
+    request.WriteInt32(document_id);
+    request.WriteString(document);
+    request.WriteUint8(static_cast<uint8_t>(status));
+    request.WriteUint32(static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        request.WriteInt32(rating);
+    }
+    Shard& shard = shards_[ShardedSearchServer::GetShardIndex(document_id, shards_.size())];
+    if (!Call(shard, ShardRequestType::ADD_DOCUMENT, request.GetData(), std::chrono::steady_clock::now() + timeout_)) {
+        throw std::runtime_error("shard "s + shard.socket_path + " is unavailable"s);
+    }
+}
+
+void RemoteShardedSearchServer::RemoveDocument(int document_id) {
+    MessageWriter request;
+    request.WriteInt32(document_id);
+    Shard& shard = shards_[ShardedSearchServer::GetShardIndex(document_id, shards_.size())];
+    if (!Call(shard, ShardRequestType::REMOVE_DOCUMENT, request.GetData(), std::chrono::steady_clock::now() + timeout_)) {
+        throw std::runtime_error("shard "s + shard.socket_path + " is unavailable"s);
+    }
+}
+
+std::vector<Document> RemoteShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_k) {
+    MessageWriter count_request;
+    count_request.WriteString(raw_query);
+    const auto count_responses = CallAll(ShardRequestType::GET_WORD_DOCUMENT_COUNTS,
+        std::vector<std::string>(shards_.size(), count_request.GetData()));
+
+    // IDF считается по ответившим шардам: выдача без упавшего шарда согласована сама с собой
+    size_t document_count = 0;
+    std::map<std::string, int, std::less<>> word_document_counts;
+    for (const auto& response : count_responses) {
+        if (!response) {
+            continue;
+        }
+        MessageReader reader(*response);
+        document_count += reader.ReadUint32();
+        for (uint32_t i = reader.ReadCount(sizeof(uint32_t) + sizeof(int32_t)); i > 0; --i) {
+            const std::string_view word = reader.ReadString();
+            const int word_document_count = reader.ReadInt32();
+            auto it = word_document_counts.find(word);
+            if (it == word_document_counts.end()) {
+                it = word_document_counts.emplace(word, 0).first;
+            }
+            it->second += word_document_count;
+        }
+    }
+
+    MessageWriter find_request;
+    find_request.WriteString(raw_query);
+    find_request.WriteUint8(static_cast<uint8_t>(status));
+    find_request.WriteUint32(static_cast<uint32_t>(top_k));
+    find_request.WriteUint32(static_cast<uint32_t>(word_document_counts.size()));
+    for (const auto& [word, word_document_count] : word_document_counts) {
+        find_request.WriteString(word);
+        find_request.WriteDouble(std::log(document_count * 1.0 / word_document_count));
+    }
+    const auto find_responses = CallAll(ShardRequestType::FIND_TOP_DOCUMENTS,
+        std::vector<std::string>(shards_.size(), find_request.GetData()));
+
+    std::vector<std::vector<Document>> shard_documents;
+    responded_shard_count_ = 0;
+    for (const auto& response : find_responses) {
+        if (!response) {
+            continue;
+        }
+        ++responded_shard_count_;
+        MessageReader reader(*response);
+        std::vector<Document>& documents = shard_documents.emplace_back(reader.ReadCount(sizeof(int32_t) + sizeof(double) + sizeof(int32_t)));
+        for (Document& document : documents) {
+            document.id = reader.ReadInt32();
+            document.relevance = reader.ReadDouble();
+            document.rating = reader.ReadInt32();
+        }
+    }
+    return MergeTopK(std::move(shard_documents), top_k, SearchServer::IsMoreRelevant);
+}
+
+size_t RemoteShardedSearchServer::GetRespondedShardCount() const {
+    return responded_shard_count_;
+}
+
+void RemoteShardedSearchServer::Shutdown() {
+    CallAll(ShardRequestType::SHUTDOWN, std::vector<std::string>(shards_.size()));
+    for (Shard& shard : shards_) {
+        Disconnect(shard);
+    }
+}
+
+bool RemoteShardedSearchServer::Connect(Shard& shard) {
+    if (shard.fd < 0) {
+        shard.fd = ConnectUnixSocket(shard.socket_path);
+    }
+    return shard.fd >= 0;
+}
+
+void RemoteShardedSearchServer::Disconnect(Shard& shard) {
+    if (shard.fd >= 0) {
+        close(shard.fd);
+        shard.fd = -1;
+    }
+}
+
+bool RemoteShardedSearchServer::SendRequest(Shard& shard, ShardRequestType type, std::string_view request, Deadline deadline) {
+    if (!Connect(shard) || !SendMessage(shard.fd, static_cast<uint8_t>(type), request, deadline)) {
+        Disconnect(shard);
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::string> RemoteShardedSearchServer::ReceiveResponse(Shard& shard, ShardRequestType type, Deadline deadline) {
+    uint8_t response_type = 0;
+    std::string response;
+    // ответ, не дождавшийся срока, остался бы в сокете, поэтому после таймаута соединение закрывается
+    if (!ReceiveMessage(shard.fd, response_type, response, deadline) || response_type != static_cast<uint8_t>(type)) {
+        Disconnect(shard);
+        return std::nullopt;
+    }
+    // усечённый ответ считается отказом шарда, как и ответ чужого типа: исключение прервало бы
+    // чтение ответов остальных шардов, и следующий вызов принял бы их за свои
+    ShardResponseStatus status;
+    std::string body;
+    try {
+        MessageReader reader(response);
+        status = static_cast<ShardResponseStatus>(reader.ReadUint8());
+        body = reader.ReadString();
+    }
+    catch (const std::runtime_error&) {
+        Disconnect(shard);
+        return std::nullopt;
+    }
+    if (status == ShardResponseStatus::INVALID_ARGUMENT) {
+        throw std::invalid_argument(body);
+    }
+    return body;
+}
+
+std::optional<std::string> RemoteShardedSearchServer::Call(Shard& shard, ShardRequestType type, std::string_view request, Deadline deadline) {
+    if (!SendRequest(shard, type, request, deadline)) {
+        return std::nullopt;
+    }
+    return ReceiveResponse(shard, type, deadline);
+}
+
+// Запросы уходят всем шардам до того, как читается первый ответ, поэтому шарды работают одновременно
+std::vector<std::optional<std::string>> RemoteShardedSearchServer::CallAll(ShardRequestType type, const std::vector<std::string>& requests) {
+    const Deadline deadline = std::chrono::steady_clock::now() + timeout_;
+    std::vector<bool> is_sent(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        is_sent[i] = SendRequest(shards_[i], type, requests[i], deadline);
+    }
+    std::vector<std::optional<std::string>> responses(shards_.size());
+    std::exception_ptr error;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!is_sent[i]) {
+            continue;
+        }
+        // ответы остальных шардов дочитываются и после ошибки, чтобы не оставить их в сокетах
+        try {
+            responses[i] = ReceiveResponse(shards_[i], type, deadline);
+        }
+        catch (const std::invalid_argument&) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return responses;
+}
+
+#endif
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+#include "shard_protocol.h"
+
+// Агрегатор шардов, работающих отдельными процессами (см. shard_process.h) и доступных по Unix-сокетам.
+// Документы распределяются по шардам так же, как в ShardedSearchServer. Запрос рассылается всем шардам
+// в два шага — сбор числа документов со словами для глобального IDF и поиск с этими IDF — и выдачи
+// сливаются. Каждый шаг ждёт ответа шарда не дольше timeout: шард, который не ответил или упал,
+// отключается и пропускается, а выдача собирается из остальных. К отключённому шарду агрегатор
+// подключается заново при следующем обращении, поэтому перезапущенный шард возвращается в работу сам.
+class RemoteShardedSearchServer {
+public:
+    RemoteShardedSearchServer(std::vector<std::string> socket_paths, std::chrono::milliseconds timeout);
+
+    RemoteShardedSearchServer(const RemoteShardedSearchServer&) = delete;
+    RemoteShardedSearchServer& operator=(const RemoteShardedSearchServer&) = delete;
+
+    ~RemoteShardedSearchServer();
+
+    size_t GetShardCount() const;
+
+    // Ошибки документа приходят от шарда как std::invalid_argument; недоступный шард — std::runtime_error
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
+
+    // Сколько шардов ответило на последний запрос
+    size_t GetRespondedShardCount() const;
+
+    // Останавливает процессы всех доступных шардов
+    void Shutdown();
+
+private:
+    struct Shard {
+        std::string socket_path;
+        int fd = -1;
+    };
+
+    std::vector<Shard> shards_;
+    std::chrono::milliseconds timeout_;
+    size_t responded_shard_count_ = 0;
+
+    bool Connect(Shard& shard);
+
+    void Disconnect(Shard& shard);
+
+    // При ошибке сокета отключает шард и возвращает false
+    bool SendRequest(Shard& shard, ShardRequestType type, std::string_view request, Deadline deadline);
+
+    // Нагрузка ответа; при ошибке или таймауте отключает шард и возвращает nullopt.
+    // Отказ шарда выполнить запрос пробрасывается как std::invalid_argument.
+    std::optional<std::string> ReceiveResponse(Shard& shard, ShardRequestType type, Deadline deadline);
+
+    // Отправляет запрос шарду и ждёт ответа; при ошибке или таймауте отключает шард и возвращает nullopt
+    std::optional<std::string> Call(Shard& shard, ShardRequestType type, std::string_view request, Deadline deadline);
+
+    // Рассылает запросы всем шардам и собирает ответы до общего срока; ответы отсутствуют у недоступных шардов
+    std::vector<std::optional<std::string>> CallAll(ShardRequestType type, const std::vector<std::string>& requests);
+};
+
+#endif
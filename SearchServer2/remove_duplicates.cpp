@@ -34,7 +34,5 @@ void RemoveDuplicates(SearchServer& search_server) {
 		}
 	}
 
-	for (int id : found_duplicates) {
-		search_server.RemoveDocument(id);
-	}
+	search_server.RemoveDocuments(found_duplicates);
 }
\ No newline at end of file
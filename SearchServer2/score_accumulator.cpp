@@ -0,0 +1,63 @@
+﻿#include "score_accumulator.h"
+
+#include <algorithm>
+
+// Плотный массив выгоднее, когда совпадений не меньше восьмой части документов:
+// он занимает 9 байт на документ, хеш-таблица — 32 байта на совпадение
+ScoreAccumulator::ScoreAccumulator(int ordinal_count, size_t expected_count)
+    : is_dense_(expected_count * 8 >= static_cast<size_t>(ordinal_count)) {
+    if (is_dense_) {
+        scores_.assign(ordinal_count, 0.0);
+        is_present_.assign(ordinal_count, 0);
+        return;
+    }
+    size_t capacity = 16;
+    while (capacity < expected_count * 2) {
+        capacity *= 2;
+    }
+    slots_.resize(capacity);
+}
+
+void ScoreAccumulator::Merge(const ScoreAccumulator& other) {
+    if (is_dense_ && other.is_dense_ && scores_.size() == other.scores_.size()) {
+        for (size_t ordinal = 0; ordinal < scores_.size(); ++ordinal) {
+            scores_[ordinal] += other.scores_[ordinal];
+            is_present_[ordinal] |= other.is_present_[ordinal];
+        }
+        return;
+    }
+    for (const auto& [ordinal, score] : other.Extract()) {
+        Add(ordinal, score);
+    }
+}
+
+std::vector<std::pair<int, double>> ScoreAccumulator::Extract() const {
+    std::vector<std::pair<int, double>> result;
+    if (is_dense_) {
+        for (size_t ordinal = 0; ordinal < scores_.size(); ++ordinal) {
+            if (is_present_[ordinal]) {
+                result.emplace_back(static_cast<int>(ordinal), scores_[ordinal]);
+            }
+        }
+        return result;
+    }
+    result.reserve(used_slot_count_);
+    for (const Slot& slot : slots_) {
+        if (slot.ordinal != EMPTY_SLOT) {
+            result.emplace_back(slot.ordinal, slot.score);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void ScoreAccumulator::Grow() {
+    std::vector<Slot> old_slots = std::move(slots_);
+    slots_.assign(std::max<size_t>(16, old_slots.size() * 2), Slot());
+    used_slot_count_ = 0;
+    for (const Slot& slot : old_slots) {
+        if (slot.ordinal != EMPTY_SLOT) {
+            FindOrInsert(slot.ordinal).score = slot.score;
+        }
+    }
+}
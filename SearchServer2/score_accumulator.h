@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Накопитель релевантностей документов, адресуемых внутренними порядковыми номерами.
+// Если ожидается, что совпадёт заметная доля документов, суммы лежат в плотном массиве по всем
+// номерам, иначе — в хеш-таблице с открытой адресацией. Накопитель не синхронизирован:
+// при параллельном поиске у каждого потока свой, и они сливаются один раз в конце.
+class ScoreAccumulator {
+public:
+    ScoreAccumulator() = default;
+
+    // ordinal_count — граница номеров документов, expected_count — оценка сверху числа разных документов
+    ScoreAccumulator(int ordinal_count, size_t expected_count);
+
+    bool IsDense() const {
+        return is_dense_;
+    }
+
+    void Add(int ordinal, double score) {
+        if (is_dense_) {
+            scores_[ordinal] += score;
+            is_present_[ordinal] = 1;
+            return;
+        }
+        FindOrInsert(ordinal).score += score;
+    }
+
+    void Merge(const ScoreAccumulator& other);
+
+    // Накопленные пары (номер документа, релевантность) по возрастанию номера
+    std::vector<std::pair<int, double>> Extract() const;
+
+private:
+    static constexpr int EMPTY_SLOT = -1;
+
+    struct Slot {
+        int ordinal = EMPTY_SLOT;
+        double score = 0.0;
+    };
+
+    bool is_dense_ = false;
+
+    std::vector<double> scores_;
+    std::vector<uint8_t> is_present_;
+
+    std::vector<Slot> slots_;
+    size_t used_slot_count_ = 0;
+
+    static size_t Hash(int ordinal) {
+        return static_cast<size_t>((static_cast<uint64_t>(ordinal) * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    Slot& FindOrInsert(int ordinal) {
+        // заполненность таблицы держится не выше половины
+        if ((used_slot_count_ + 1) * 2 > slots_.size()) {
+            Grow();
+        }
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = Hash(ordinal) & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots_[i];
+            if (slot.ordinal == ordinal) {
+                return slot;
+            }
+            if (slot.ordinal == EMPTY_SLOT) {
+                slot.ordinal = ordinal;
+                ++used_slot_count_;
+                return slot;
+            }
+        }
+    }
+
+    void Grow();
+};
@@ -1,32 +1,196 @@
 ﻿#include "search_server.h"
 #include "string_processing.h"
+#include "index_file.h"
 
+#include <exception>
 #include <execution>
+#include <fstream>
 #include <mutex>
+#include <unordered_set>
 
 using namespace std::literals::string_literals;
 
 SearchServer::SearchServer(const std::string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+    : SearchServer(WordRange(stop_words_text))  // Invoke delegating constructor from string container
 {}
 
 SearchServer::SearchServer(const std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+    : SearchServer(WordRange(stop_words_text))  // Invoke delegating constructor from string container
 {}
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (FindOrdinal(document_id) != NO_ORDINAL)) {
         throw std::invalid_argument("document contains wrong id"s);
     }
+    // разбор до изменения индекса: на некорректном слове сервер остаётся нетронутым.
+    // Слова хранит словарь, поэтому они берутся прямо из переданного текста.
+    std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
 
-    document_ids_.insert(document_id);
-    const auto [it, inserted] = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, std::string(document) });
-    std::vector<std::string_view> words = SplitIntoWordsNoStop(it->second.text);
+    const int ordinal = AppendDocumentRecord(document_id, document, status, ratings);
 
     const double inv_word_count = 1.0 / words.size();
-    for (const auto word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        doc_id_to_words_freqs_[document_id][word] += inv_word_count;
+    std::vector<TermId> term_ids(words.size());
+    std::transform(words.begin(), words.end(), term_ids.begin(),
+        [this](std::string_view word) {
+            return terms_.Intern(word);
+        });
+    index_.ReserveTerms(terms_.Size());
+    term_document_counts_.Resize(terms_.Size());
+    int* const term_document_counts = term_document_counts_.MutableData();
+
+    std::sort(term_ids.begin(), term_ids.end());
+    TermFreqs term_freqs;
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const TermId term_id = *it;
+        double term_freq = 0.0;
+        for (; it != term_ids.end() && *it == term_id; ++it) {
+            term_freq += inv_word_count;
+        }
+        term_freqs.push_back({ term_id, term_freq });
+        index_.AddPosting(term_id, ordinal, term_freq);
+        ++term_document_counts[term_id];
+    }
+    doc_id_to_words_freqs_.AppendRow(std::move(term_freqs));
+    index_.FinishDocuments(ordinal + 1);
+    ++index_generation_;
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<NewDocument>& documents) {
+    AddDocuments(&policy, documents);
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy& policy, const std::vector<NewDocument>& documents) {
+    AddDocuments(&policy, documents);
+}
+
+// Пакет добавляется в три шага. Сначала документы параллельно разбираются на слова, и каждый поток
+// собирает частичный обратный индекс своей части пакета по словам. Затем по порядку проверяются id
+// и находится первый документ с ошибкой. Наконец, документы до него за один проход вливаются в индекс,
+// после чего бросается исключение этого документа — так же, как при поочерёдных вызовах AddDocument.
+// Последовательно при слиянии только заводятся термы в словаре: списки постингов разных термов
+// и прямой индекс разных документов заполняются параллельно.
+template <typename ExecutionPolicy>
+void SearchServer::AddDocuments(const ExecutionPolicy* policy, const std::vector<NewDocument>& documents) {
+    // частичный индекс части пакета: слово -> (номер документа в пакете, tf) по возрастанию номера
+    using Postings = std::vector<std::pair<size_t, double>>;
+    using PartialIndex = std::unordered_map<std::string_view, Postings>;
+
+    constexpr bool is_sequenced = std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>;
+    const size_t chunk_count = is_sequenced ? 1
+        : std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), documents.size()));
+    const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+    std::vector<PartialIndex> partial_indexes(chunk_count);
+    // прямой индекс пакета: пары (слово, tf), упорядоченные по слову
+    std::vector<std::vector<std::pair<std::string_view, double>>> document_words(documents.size());
+    std::vector<std::exception_ptr> word_errors(documents.size());
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+
+    std::for_each(*policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        const size_t last = std::min(documents.size(), (chunk + 1) * chunk_size);
+        for (size_t index = chunk * chunk_size; index < last; ++index) {
+            std::vector<std::string_view> words;
+            try {
+                words = SplitIntoWordsNoStop(documents[index].text);
+            }
+            catch (const std::invalid_argument&) {
+                word_errors[index] = std::current_exception();
+                continue;
+            }
+            // tf набирается повторным сложением, как в AddDocument, чтобы совпасть с ним до бита
+            const double inv_word_count = 1.0 / words.size();
+            std::sort(words.begin(), words.end());
+            for (auto it = words.begin(); it != words.end();) {
+                double term_freq = 0.0;
+                const auto next = std::find_if(it, words.end(), [it](std::string_view word) { return word != *it; });
+                for (; it != next; ++it) {
+                    term_freq += inv_word_count;
+                }
+                partial_indexes[chunk][*(it - 1)].emplace_back(index, term_freq);
+                document_words[index].emplace_back(*(it - 1), term_freq);
+            }
+        }
+        });
+
+    size_t accepted_count = 0;
+    std::exception_ptr error;
+    std::unordered_set<int> batch_document_ids;
+    for (; accepted_count < documents.size(); ++accepted_count) {
+        const int document_id = documents[accepted_count].id;
+        if (document_id < 0 || FindOrdinal(document_id) != NO_ORDINAL || !batch_document_ids.insert(document_id).second) {
+            error = std::make_exception_ptr(std::invalid_argument("document contains wrong id"s));
+            break;
+        }
+        if (word_errors[accepted_count]) {
+            error = word_errors[accepted_count];
+            break;
+        }
+    }
+
+    if (accepted_count > 0) {
+        const int first_ordinal = static_cast<int>(ordinal_to_document_id_.Size());
+        for (size_t index = 0; index < accepted_count; ++index) {
+            const NewDocument& document = documents[index];
+            AppendDocumentRecord(document.id, document.text, document.status, document.ratings);
+        }
+
+        // постинги принятых документов в порядке частей: новые ordinal больше всех прежних,
+        // поэтому внутри терма они дописываются в конец списка
+        std::vector<std::pair<TermId, std::pair<Postings::const_iterator, Postings::const_iterator>>> term_postings;
+        for (const PartialIndex& partial_index : partial_indexes) {
+            for (const auto& [word, postings] : partial_index) {
+                const auto postings_end = std::lower_bound(postings.begin(), postings.end(), std::make_pair(accepted_count, 0.0));
+                if (postings_end != postings.begin()) {
+                    term_postings.push_back({ terms_.Intern(word), { postings.begin(), postings_end } });
+                }
+            }
+        }
+        index_.ReserveTerms(terms_.Size());
+        term_document_counts_.Resize(terms_.Size());
+        int* const term_document_counts = term_document_counts_.MutableData();
+        std::stable_sort(term_postings.begin(), term_postings.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first < rhs.first;
+            });
+
+        std::vector<size_t> term_starts;
+        for (size_t i = 0; i < term_postings.size(); ++i) {
+            if (i == 0 || term_postings[i].first != term_postings[i - 1].first) {
+                term_starts.push_back(i);
+            }
+        }
+        std::for_each(*policy, term_starts.begin(), term_starts.end(), [&](size_t start) {
+            const TermId term_id = term_postings[start].first;
+            for (size_t i = start; i < term_postings.size() && term_postings[i].first == term_id; ++i) {
+                for (auto it = term_postings[i].second.first; it != term_postings[i].second.second; ++it) {
+                    index_.AddPosting(term_id, first_ordinal + static_cast<int>(it->first), it->second);
+                    ++term_document_counts[term_id];
+                }
+            }
+            });
+
+        doc_id_to_words_freqs_.ResizeRows(first_ordinal + accepted_count);
+        std::vector<size_t> indexes(accepted_count);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(*policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            TermFreqs& term_freqs = doc_id_to_words_freqs_.GetMutableRow(first_ordinal + index);
+            term_freqs.reserve(document_words[index].size());
+            for (const auto& [word, term_freq] : document_words[index]) {
+                term_freqs.push_back({ terms_.Find(word), term_freq });
+            }
+            std::sort(term_freqs.begin(), term_freqs.end(), [](const TermFreq& lhs, const TermFreq& rhs) {
+                return lhs.term_id < rhs.term_id;
+                });
+            });
+        index_.FinishDocuments(first_ordinal + static_cast<int>(accepted_count));
+        ++index_generation_;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
     }
 }
 
@@ -42,10 +206,8 @@ SearchServer::MatchDocumentResult SearchServer::MatchDocument(const std::executi
     return MatchDocument(&policy, raw_query, document_id);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [&status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(raw_query, StatusPredicate{ status }, top_k);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
@@ -53,23 +215,35 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 }
 
 size_t SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ids_.Size() - removed_id_count_ + added_document_ordinals_.size();
+}
+
+int SearchServer::GetWordDocumentCount(std::string_view word) const {
+    const TermId term_id = terms_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : term_document_counts_[term_id];
+}
+
+uint64_t SearchServer::GetIndexGeneration() const {
+    return index_generation_;
 }
 
-std::set<int>::const_iterator SearchServer::begin() {
+Column<int>::const_iterator SearchServer::begin() {
+    CompactDocumentIds();
     return document_ids_.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() {
+Column<int>::const_iterator SearchServer::end() {
+    CompactDocumentIds();
     return document_ids_.end();
 }
 
 //Метод получения частот слов по id документа
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if (doc_id_to_words_freqs_.count(document_id)) {
+    if (const int ordinal = FindOrdinal(document_id); ordinal != NO_ORDINAL) {
         static std::map<std::string_view, double> m;
-        for (auto p : doc_id_to_words_freqs_.at(document_id)){
-            m[p.first] = p.second;
+        m.clear();
+        for (const auto [term_id, term_freq] : GetDocumentTerms(ordinal)) {
+            m[terms_.GetWord(term_id)] = term_freq;
         }
         return m;
     }
@@ -83,72 +257,242 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
-    if (document_ids_.count(document_id) == 1) {
-        for (const auto [search_word, _] : doc_id_to_words_freqs_[document_id]) {
-            std::string found_word = static_cast<std::string>(search_word);
-            word_to_document_freqs_[found_word].erase(document_id);
-            if (word_to_document_freqs_[found_word].empty()) {
-                word_to_document_freqs_.erase(found_word);
-            }
-        }
-        document_ids_.erase(document_id);
-        documents_.erase(document_id);
-        doc_id_to_words_freqs_.erase(document_id);
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal == NO_ORDINAL) {
+        return;
     }
+    const ColumnRow<TermFreq> term_freqs = GetDocumentTerms(ordinal);
+    // постинги остаются в индексе до слияния сегментов, а запросы пропускают документ сразу
+    index_.RemoveDocument(ordinal);
+    int* const term_document_counts = term_document_counts_.MutableData();
+    for (const auto [term_id, _] : term_freqs) {
+        --term_document_counts[term_id];
+    }
+    EraseDocumentRecord(document_id, ordinal);
 }
 
 ////Вы можете столкнуться с тем, что нужный алгоритм не параллелится, когда передаёте в него итераторы не произвольного доступа.
 //Попробуйте переложить нужные элементы в вектор и запустить алгоритм для него.
 void SearchServer::RemoveDocument(const std::execution::parallel_policy& police, int document_id) {
-    if (!documents_.count(document_id)) return;
-    const auto& word_freqs = doc_id_to_words_freqs_.at(document_id);
-    std::vector<std::string_view> words(word_freqs.size());
-    std::transform(
-        std::execution::par,
-        word_freqs.begin(), word_freqs.end(),
-        words.begin(),
-        [](const auto& item) { return item.first; }
-    );
-    std::mutex m;
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal == NO_ORDINAL) return;
+    // id термов документа уникальны, поэтому каждая задача правит свой счётчик
+    const ColumnRow<TermFreq> term_freqs = GetDocumentTerms(ordinal);
+    index_.RemoveDocument(ordinal);
+    int* const term_document_counts = term_document_counts_.MutableData();
     std::for_each(
         std::execution::par,
-        words.begin(), words.end(),
-        [&m, 
-        this, &document_id](const auto& word) {
-            std::lock_guard<std::mutex> guard(m);
-            if (word_to_document_freqs_.count(word)){
-                word_to_document_freqs_.at(word).erase(document_id);
-            }
+        term_freqs.begin(), term_freqs.end(),
+        [term_document_counts](const TermFreq& term_freq) {
+            --term_document_counts[term_freq.term_id];
+        });
+    EraseDocumentRecord(document_id, ordinal);
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    RemoveDocuments(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::sequenced_policy& policy, const std::vector<int>& document_ids) {
+    RemoveDocuments(&policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::parallel_policy& policy, const std::vector<int>& document_ids) {
+    RemoveDocuments(&policy, document_ids);
+}
+
+// Термы всех удаляемых документов собираются в один список и сортируются, так что каждый терм
+// встречается одной группой: его счётчик документов уменьшается один раз на размер группы,
+// а разные группы обрабатываются параллельно без блокировок.
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocuments(const ExecutionPolicy* policy, const std::vector<int>& document_ids) {
+    std::vector<int> removed_ids;
+    for (const int document_id : document_ids) {
+        if (FindOrdinal(document_id) != NO_ORDINAL) {
+            removed_ids.push_back(document_id);
+        }
+    }
+    std::sort(removed_ids.begin(), removed_ids.end());
+    removed_ids.erase(std::unique(removed_ids.begin(), removed_ids.end()), removed_ids.end());
+    if (removed_ids.empty()) {
+        return;
+    }
+
+    std::vector<int> ordinals(removed_ids.size());
+    std::transform(removed_ids.begin(), removed_ids.end(), ordinals.begin(), [this](int document_id) {
+        return FindOrdinal(document_id);
+        });
+    std::vector<TermId> term_ids;
+    for (const int ordinal : ordinals) {
+        for (const auto [term_id, _] : GetDocumentTerms(ordinal)) {
+            term_ids.push_back(term_id);
+        }
+    }
+    std::sort(*policy, term_ids.begin(), term_ids.end());
+    std::vector<size_t> term_starts;
+    for (size_t i = 0; i < term_ids.size(); ++i) {
+        if (i == 0 || term_ids[i] != term_ids[i - 1]) {
+            term_starts.push_back(i);
+        }
+    }
+    int* const term_document_counts = term_document_counts_.MutableData();
+    std::for_each(*policy, term_starts.begin(), term_starts.end(), [&](size_t start) {
+        const auto last = std::upper_bound(term_ids.begin() + start, term_ids.end(), term_ids[start]);
+        term_document_counts[term_ids[start]] -= static_cast<int>(last - term_ids.begin() - start);
+        });
+
+    index_.RemoveDocuments(ordinals);
+    for (size_t i = 0; i < removed_ids.size(); ++i) {
+        ReleaseDocumentRow(ordinals[i]);
+        if (added_document_ordinals_.erase(removed_ids[i]) == 0) {
+            CountRemovedId();
+        }
+    }
+    ++index_generation_;
+}
+
+// Заводит строки столбцов нового документа; индекс и прямой индекс заполняет вызывающий
+int SearchServer::AppendDocumentRecord(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    const int ordinal = static_cast<int>(ordinal_to_document_id_.Size());
+    added_document_ordinals_.emplace(document_id, ordinal);
+    ordinal_to_document_id_.PushBack(document_id);
+    ratings_.PushBack(ComputeAverageRating(ratings));
+    statuses_.PushBack(status);
+    for (DynamicBitset& documents : status_documents_) {
+        documents.Resize(ordinal + 1);
+    }
+    status_documents_[static_cast<int>(status)].Set(ordinal);
+    texts_.AppendRow(std::vector<char>(document.begin(), document.end()));
+    return ordinal;
+}
+
+// Порядковые номера не переиспользуются: строки столбцов удалённого документа лишь освобождают память
+void SearchServer::EraseDocumentRecord(int document_id, int ordinal) {
+    ReleaseDocumentRow(ordinal);
+    if (added_document_ordinals_.erase(document_id) == 0) {
+        CountRemovedId();
+    }
+    ++index_generation_;
+}
+
+// Всё, что можно освободить по одному документу; отображение id правит вызывающий.
+// Бит сбрасывается во всех картах статусов: статус из файла индекса не проверяется и не служит индексом.
+void SearchServer::ReleaseDocumentRow(int ordinal) {
+    for (DynamicBitset& documents : status_documents_) {
+        documents.Reset(ordinal);
+    }
+    doc_id_to_words_freqs_.ReleaseRow(ordinal);
+    texts_.ReleaseRow(ordinal);
+}
+
+ColumnRow<SearchServer::TermFreq> SearchServer::GetDocumentTerms(int ordinal) const {
+    const ColumnRow<TermFreq> term_freqs = doc_id_to_words_freqs_.GetRow(ordinal);
+    const size_t term_count = terms_.Size();
+    for (size_t i = 0; i < term_freqs.Size(); ++i) {
+        if (term_freqs[i].term_id >= term_count || (i > 0 && term_freqs[i].term_id <= term_freqs[i - 1].term_id)) {
+            ThrowDamagedIndexFile("document terms"s);
+        }
+    }
+    return term_freqs;
+}
+
+bool SearchServer::IsLiveOrdinal(int ordinal) const {
+    return std::any_of(status_documents_.begin(), status_documents_.end(), [ordinal](const DynamicBitset& documents) {
+        return documents.Test(ordinal);
         });
-    document_ids_.erase(document_id);
-    documents_.erase(document_id);
-    doc_id_to_words_freqs_.erase(document_id);
+}
+
+// ordinal из файла индекса проверяется при чтении: им индексируются все столбцы документов
+int SearchServer::GetIdColumnOrdinal(size_t position) const {
+    const int ordinal = document_id_ordinals_[position];
+    if (ordinal < 0 || static_cast<size_t>(ordinal) >= ordinal_to_document_id_.Size()) {
+        ThrowDamagedIndexFile("document ids"s);
+    }
+    return ordinal;
+}
+
+void SearchServer::CountRemovedId() {
+    if (++removed_id_count_ * 4 >= document_ids_.Size()) {
+        CompactDocumentIds();
+    }
+}
+
+std::pair<std::vector<int>, std::vector<int>> SearchServer::CollectDocumentIds() const {
+    std::vector<std::pair<int, int>> added(added_document_ordinals_.begin(), added_document_ordinals_.end());
+    std::sort(added.begin(), added.end());
+    std::vector<int> ids;
+    std::vector<int> ordinals;
+    ids.reserve(GetDocumentCount());
+    ordinals.reserve(GetDocumentCount());
+    auto added_it = added.begin();
+    const auto append_added = [&](const auto last) {
+        for (; added_it != last; ++added_it) {
+            ids.push_back(added_it->first);
+            ordinals.push_back(added_it->second);
+        }
+    };
+    for (size_t position = 0; position < document_ids_.Size(); ++position) {
+        const int ordinal = GetIdColumnOrdinal(position);
+        if (!IsLiveOrdinal(ordinal)) {
+            continue;
+        }
+        append_added(std::lower_bound(added_it, added.end(), std::make_pair(document_ids_[position], 0)));
+        ids.push_back(document_ids_[position]);
+        ordinals.push_back(ordinal);
+    }
+    append_added(added.end());
+    return { std::move(ids), std::move(ordinals) };
+}
+
+void SearchServer::CompactDocumentIds() {
+    if (removed_id_count_ == 0 && added_document_ordinals_.empty()) {
+        return;
+    }
+    auto [ids, ordinals] = CollectDocumentIds();
+    document_ids_ = Column<int>(std::move(ids));
+    document_id_ordinals_ = Column<int>(std::move(ordinals));
+    added_document_ordinals_.clear();
+    removed_id_count_ = 0;
+}
+
+int SearchServer::FindOrdinal(int document_id) const {
+    if (const auto it = added_document_ordinals_.find(document_id); it != added_document_ordinals_.end()) {
+        return it->second;
+    }
+    const auto it = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return NO_ORDINAL;
+    }
+    const int ordinal = GetIdColumnOrdinal(it - document_ids_.begin());
+    return IsLiveOrdinal(ordinal) ? ordinal : NO_ORDINAL;
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
+// Недопустимые символы ищутся в том же проходе, что и границы слов
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
     std::vector<std::string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + static_cast<std::string>(word) + " is invalid"s);
+    const WordRange range(text);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        if (!it.IsValid()) {
+            throw std::invalid_argument("Word "s + static_cast<std::string>(*it) + " is invalid"s);
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+        if (!IsStopWord(*it)) {
+            words.push_back(*it);
         }
     }
     return words;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text, bool is_valid) const {
     bool is_minus = false;
     if (text[0] == '-') {
         is_minus = true;
         text = text.substr(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    if (text.empty() || text[0] == '-' || !is_valid) {
         throw std::invalid_argument("Query word "s + static_cast<std::string>(text) + " is invalid");
     }
 
@@ -167,6 +511,176 @@ SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_poli
     return ParseQuery(&policy, text);
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
-}
\ No newline at end of file
+// На пути запроса IDF — одно чтение из таблицы; логарифмы пересчитываются один раз на поколение индекса
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+    return inverse_document_freqs_.Get(index_generation_, [this](std::vector<double>& table) {
+        const double document_count = GetDocumentCount() * 1.0;
+        table.resize(term_document_counts_.Size());
+        for (size_t term = 0; term < table.size(); ++term) {
+            table[term] = term_document_counts_[term] == 0 ? 0.0 : log(document_count / term_document_counts_[term]);
+        }
+        })[term_id];
+}
+
+void SearchServer::Freeze() {
+    index_.Compact();
+}
+
+bool SearchServer::IsFrozen() const {
+    return index_.IsCompact();
+}
+
+void SearchServer::SetSegmentDocumentLimit(size_t limit) {
+    index_.SetSegmentDocumentLimit(limit);
+}
+
+size_t SearchServer::GetSegmentCount() const {
+    return index_.GetSegmentCount();
+}
+
+void SearchServer::SetRetrievalAlgorithm(RetrievalAlgorithm algorithm) {
+    retrieval_algorithm_ = algorithm;
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    search_queries_.SetCapacity(capacity);
+}
+
+RetrievalAlgorithm SearchServer::GetRetrievalAlgorithm() const {
+    return retrieval_algorithm_;
+}
+
+size_t SearchServer::GetTermDocumentCount(TermId term_id) const {
+    return term_document_counts_[term_id];
+}
+static IndexSection GetStatusSection(int status) {
+    return static_cast<IndexSection>(static_cast<uint32_t>(IndexSection::STATUS_DOCUMENTS) + status);
+}
+
+// Строки пишутся в формате CSR: границы строк и значения всех строк подряд
+template <typename T>
+static void WriteRaggedColumn(IndexFileWriter& writer, IndexSection offsets_section, IndexSection values_section, const RaggedColumn<T>& column) {
+    std::vector<uint64_t> offsets = { 0 };
+    offsets.reserve(column.RowCount() + 1);
+    for (size_t row = 0; row < column.RowCount(); ++row) {
+        offsets.push_back(offsets.back() + column.GetRow(row).Size());
+    }
+    std::vector<T> values(offsets.back());
+    for (size_t row = 0; row < column.RowCount(); ++row) {
+        const ColumnRow<T> values_row = column.GetRow(row);
+        std::copy(values_row.begin(), values_row.end(), values.begin() + offsets[row]);
+    }
+    writer.WriteColumn(offsets_section, offsets.data(), offsets.size());
+    writer.WriteColumn(values_section, values.data(), values.size());
+}
+
+void SearchServer::SaveIndexFile(const std::string& path) const {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("cannot create index file "s + path);
+    }
+    SaveSnapshot(output);
+}
+
+SearchServer SearchServer::OpenMapped(const std::string& path) {
+    return FromIndexFile(IndexFile::Map(path));
+}
+
+SearchServer SearchServer::LoadSnapshot(std::istream& input) {
+    return FromIndexFile(IndexFile::Read(input));
+}
+
+void SearchServer::SaveSnapshot(std::ostream& output) const {
+    IndexFileWriter writer(output);
+
+    std::vector<uint64_t> stop_word_offsets = { 0 };
+    std::string stop_word_chars;
+    for (size_t i = 0; i < stop_words_.Size(); ++i) {
+        stop_word_chars += stop_words_.GetWord(i);
+        stop_word_offsets.push_back(stop_word_chars.size());
+    }
+    writer.WriteColumn(IndexSection::STOP_WORD_OFFSETS, stop_word_offsets.data(), stop_word_offsets.size());
+    writer.WriteColumn(IndexSection::STOP_WORD_CHARS, stop_word_chars.data(), stop_word_chars.size());
+
+    terms_.Save(writer);
+    writer.WriteColumn(IndexSection::TERM_DOCUMENT_COUNTS, term_document_counts_);
+
+    // в файл попадают только живые документы, как после уплотнения
+    const auto [document_ids, document_id_ordinals] = CollectDocumentIds();
+    writer.WriteColumn(IndexSection::DOCUMENT_IDS, document_ids.data(), document_ids.size());
+    writer.WriteColumn(IndexSection::DOCUMENT_ID_ORDINALS, document_id_ordinals.data(), document_id_ordinals.size());
+    writer.WriteColumn(IndexSection::ORDINAL_DOCUMENT_IDS, ordinal_to_document_id_);
+    writer.WriteColumn(IndexSection::RATINGS, ratings_);
+    writer.WriteColumn(IndexSection::STATUSES, statuses_);
+    for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        writer.WriteColumn(GetStatusSection(status), status_documents_[status].GetWords());
+    }
+    WriteRaggedColumn(writer, IndexSection::TEXT_OFFSETS, IndexSection::TEXT_CHARS, texts_);
+    WriteRaggedColumn(writer, IndexSection::FORWARD_OFFSETS, IndexSection::FORWARD_TERM_FREQS, doc_id_to_words_freqs_);
+
+    index_.BuildCompactIndex().Save(writer);
+    writer.Finish();
+}
+
+SearchServer SearchServer::FromIndexFile(const IndexFile& file) {
+    const Column<uint64_t> stop_word_offsets = file.GetColumn<uint64_t>(IndexSection::STOP_WORD_OFFSETS);
+    const Column<char> stop_word_chars = file.GetColumn<char>(IndexSection::STOP_WORD_CHARS);
+    if (!AreValidOffsets(stop_word_offsets, stop_word_chars.Size())) {
+        ThrowDamagedIndexFile("stop words"s);
+    }
+    std::vector<std::string> stop_words;
+    for (size_t i = 0; i + 1 < stop_word_offsets.Size(); ++i) {
+        stop_words.emplace_back(stop_word_chars.Data() + stop_word_offsets[i], stop_word_offsets[i + 1] - stop_word_offsets[i]);
+    }
+    SearchServer server(stop_words);
+
+    server.terms_ = TermDictionary::Open(file);
+    server.term_document_counts_ = file.GetColumn<int>(IndexSection::TERM_DOCUMENT_COUNTS);
+    server.document_ids_ = file.GetColumn<int>(IndexSection::DOCUMENT_IDS);
+    server.document_id_ordinals_ = file.GetColumn<int>(IndexSection::DOCUMENT_ID_ORDINALS);
+    server.ordinal_to_document_id_ = file.GetColumn<int>(IndexSection::ORDINAL_DOCUMENT_IDS);
+    server.ratings_ = file.GetColumn<int>(IndexSection::RATINGS);
+    server.statuses_ = file.GetColumn<DocumentStatus>(IndexSection::STATUSES);
+    const size_t ordinal_count = server.ordinal_to_document_id_.Size();
+    if (ordinal_count > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        ThrowDamagedIndexFile("documents"s);
+    }
+    const int end_ordinal = static_cast<int>(ordinal_count);
+    for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        server.status_documents_[status] = DynamicBitset(ordinal_count, file.GetColumn<uint64_t>(GetStatusSection(status)));
+    }
+
+    // При открытии проверяется только то, что не зависит от числа документов: столбцы документов
+    // не читаются целиком. Границы строк проверяет RaggedColumn::GetRow, id термов строки —
+    // GetDocumentTerms, ordinal документа — FindOrdinal, постинги — FrozenIndex при первом чтении терма.
+    const Column<uint64_t> text_offsets = file.GetColumn<uint64_t>(IndexSection::TEXT_OFFSETS);
+    const Column<char> text_chars = file.GetColumn<char>(IndexSection::TEXT_CHARS);
+    const Column<uint64_t> forward_offsets = file.GetColumn<uint64_t>(IndexSection::FORWARD_OFFSETS);
+    const Column<TermFreq> forward_term_freqs = file.GetColumn<TermFreq>(IndexSection::FORWARD_TERM_FREQS);
+    if (!AreValidOffsetEndpoints(text_offsets, text_chars.Size())) {
+        ThrowDamagedIndexFile("document texts"s);
+    }
+    if (!AreValidOffsetEndpoints(forward_offsets, forward_term_freqs.Size())) {
+        ThrowDamagedIndexFile("document terms"s);
+    }
+    if (std::any_of(server.term_document_counts_.begin(), server.term_document_counts_.end(),
+        [end_ordinal](int count) { return count < 0 || count > end_ordinal; })) {
+        ThrowDamagedIndexFile("term document counts"s);
+    }
+    server.texts_ = RaggedColumn<char>(text_offsets, text_chars);
+    server.doc_id_to_words_freqs_ = RaggedColumn<TermFreq>(forward_offsets, forward_term_freqs);
+
+    // размеры столбцов должны сходиться
+    const bool is_consistent = server.term_document_counts_.Size() == server.terms_.Size()
+        && server.document_id_ordinals_.Size() == server.document_ids_.Size()
+        && server.ratings_.Size() == ordinal_count && server.statuses_.Size() == ordinal_count
+        && std::all_of(server.status_documents_.begin(), server.status_documents_.end(), [ordinal_count](const DynamicBitset& documents) {
+            return documents.GetWords().Size() == (ordinal_count + 63) / 64;
+            })
+        && server.texts_.RowCount() == ordinal_count && server.doc_id_to_words_freqs_.RowCount() == ordinal_count;
+    if (!is_consistent) {
+        ThrowDamagedIndexFile("column sizes"s);
+    }
+    server.index_.Load(FrozenIndex::Open(file, end_ordinal), end_ordinal);
+    return server;
+}
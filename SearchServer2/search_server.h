@@ -1,24 +1,69 @@
 ﻿#pragma once
 
 #include <algorithm>
+#include <array>
+#include <iosfwd>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <stdexcept>
 #include <numeric>
 #include <cmath>
+#include <limits>
 #include <execution>
 #include <mutex>
+#include <thread>
+#include <type_traits>
 
+#include "column.h"
 #include "document.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "segmented_index.h"
+#include "inverse_document_freq_cache.h"
+#include "top_k.h"
+#include "posting_cursor.h"
+#include "query_cache.h"
 
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "dynamic_bitset.h"
+#include "score_accumulator.h"
+#include "stop_word_set.h"
 
 const double EPSILON = 1e-6;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// Алгоритм отбора лучших документов.
+// EXHAUSTIVE оценивает все постинги слов запроса, WAND пропускает документы, которые
+// по верхним оценкам вклада термов уже не могут попасть в выдачу. BLOCK_MAX_WAND дополнительно
+// оценивает вклад терма по максимуму tf в блоке постингов и пропускает блоки целиком
+// (выигрыш есть только у замороженного индекса). Результаты всех алгоритмов совпадают.
+enum class RetrievalAlgorithm {
+    EXHAUSTIVE,
+    WAND,
+    BLOCK_MAX_WAND,
+};
+
+// Документ для пакетного добавления AddDocuments. Текст читается только во время вызова.
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Предикат «документ имеет статус status». Перегрузки FindTopDocuments со статусом передают его
+// вместо произвольной лямбды, а поиск распознаёт его на этапе компиляции и отбирает документы
+// по битовой карте статуса, не вызывая предикат на каждом постинге.
+struct StatusPredicate {
+    DocumentStatus status;
+
+    bool operator()(int, DocumentStatus document_status, int) const {
+        return document_status == status;
+    }
+};
+
 class SearchServer {
 
 public:
@@ -34,24 +79,57 @@ public:
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Добавляет документы так же, как поочерёдные вызовы AddDocument: при ошибке документы до ошибочного
+    // остаются добавленными и бросается то же исключение. Параллельная версия разбирает документы на слова
+    // во всех потоках и вливает их в индекс за один проход.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    // top_k задаёт максимальный размер выдачи для конкретного вызова
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query) const;
 
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // IDF слов, посчитанные вне сервера: шардированный сервер передаёт в шарды IDF по всей коллекции
+    using WordInverseDocumentFreqs = std::map<std::string, double, std::less<>>;
 
+    // Поиск с заданными IDF слов запроса; слова, которых нет в inverse_document_freqs, вклада не дают
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k,
+        const WordInverseDocumentFreqs& inverse_document_freqs) const;
 
     size_t GetDocumentCount() const;
 
+    // Число документов, содержащих слово
+    int GetWordDocumentCount(std::string_view word) const;
+
+    // Порядок выдачи: по убыванию релевантности, при равной релевантности — по убыванию рейтинга
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+            return lhs.rating > rhs.rating;
+        }
+        else {
+            return lhs.relevance > rhs.relevance;
+        }
+    }
+
+    // Поколение индекса: меняется при каждом добавлении и удалении документа.
+    // Посчитанные по индексу величины (IDF, разобранные запросы) действительны, пока поколение то же.
+    uint64_t GetIndexGeneration() const;
+
     // Поиск документов по словам запроса
     using MatchDocumentResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
@@ -62,8 +140,9 @@ public:
     template<typename ExecutionPolicy>
     MatchDocumentResult MatchDocument(const ExecutionPolicy&& exec_policy, const std::string_view raw_query, int document_id) const;
 
-    std::set<int>::const_iterator begin();
-    std::set<int>::const_iterator end();
+    // Id живых документов по возрастанию. Перед обходом столбец id уплотняется (см. CompactDocumentIds)
+    Column<int>::const_iterator begin();
+    Column<int>::const_iterator end();
 
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
@@ -72,31 +151,112 @@ public:
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
-private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string text;
-    };
+    // Пакетное удаление: счётчики документов каждого терма правятся один раз на пакет, а не на документ.
+    // Отсутствующие и повторяющиеся id пропускаются.
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
+
+    // Обратный индекс состоит из сегментов (см. segmented_index.h): новые документы попадают в изменяемый
+    // сегмент, который запечатывается в компактный CSR-сегмент по достижении лимита документов.
+    // Freeze запечатывает изменяемый сегмент и сливает все сегменты в один; следующие добавления
+    // снова попадают в изменяемый сегмент.
+    void Freeze();
+
+    // true, если все документы лежат в одном компактном сегменте
+    bool IsFrozen() const;
+
+    void SetSegmentDocumentLimit(size_t limit);
+
+    // Число сегментов индекса, включая изменяемый
+    size_t GetSegmentCount() const;
+
+    void SetRetrievalAlgorithm(RetrievalAlgorithm algorithm);
+
+    RetrievalAlgorithm GetRetrievalAlgorithm() const;
+
+    // Разобранные запросы FindTopDocuments (id термов и IDF плюс-слов) кешируются по тексту запроса
+    // до изменения индекса; некорректные запросы не кешируются и бросают исключение при каждом вызове.
+    // 0 отключает кеш. Вызывается не одновременно с поиском.
+    void SetQueryCacheCapacity(size_t capacity);
+
+    // Сохраняет сервер в файл индекса (см. index_file.h); постинги всех сегментов пишутся одним
+    // сегментом без удалённых документов. Бросает std::runtime_error, если запись не удалась.
+    void SaveIndexFile(const std::string& path) const;
 
+    // Открывает файл индекса без чтения и разбора: столбцы сервера ссылаются на отображённые в память
+    // страницы файла, которые подгружаются по мере обращения. Сервер можно изменять — изменяемый
+    // столбец копируется в память. При открытии проверяются только размеры секций, словарь и границы
+    // термов — время не зависит от числа документов. Строки документов и постинги терма проверяются
+    // при первом чтении, поэтому повреждение в них обнаруживает не OpenMapped, а запрос, дошедший
+    // до испорченного места: он бросает std::runtime_error. Тексты документов не проверяются.
+    // Бросает std::runtime_error, если файл не открывается или его структура повреждена.
+    static SearchServer OpenMapped(const std::string& path);
+
+    // Снимок сервера для быстрого перезапуска, в том же формате, что и файл индекса.
+    // Тексты при загрузке заново не разбираются: секции читаются целиком в один буфер, столбцы сервера
+    // ссылаются на него, и загрузка упирается в скорость чтения потока и подсчёта контрольных сумм.
+    void SaveSnapshot(std::ostream& output) const;
+
+    // Бросает std::runtime_error, если поток оборвался или контрольная сумма секции не сходится
+    static SearchServer LoadSnapshot(std::istream& input);
+
+private:
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
 
+    // Слова запроса, разрешённые в id словаря. Слова, которых нет в индексе, отбрасываются
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
+        // IDF плюс-слов в порядке plus_words; заполняется только для поиска
+        std::vector<double> inverse_document_freqs;
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
+    // Строка прямого индекса; хранится в файле индекса как есть, поэтому не std::pair
+    struct TermFreq {
+        TermId term_id = 0;
+        double term_freq = 0.0;
+    };
 
-    std::set<int> document_ids_;
-    std::map<int, DocumentData> documents_;
-    std::map<int, std::map<std::string_view, double>> doc_id_to_words_freqs_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::set<std::string> words_in_docs_;
+    using TermFreqs = std::vector<TermFreq>;
+
+    const StopWordSet stop_words_;
+
+    static constexpr int NO_ORDINAL = -1;
+
+    TermDictionary terms_;
+
+    // Внутри сервера документ адресуется плотным порядковым номером (ordinal), выдаваемым при добавлении.
+    // Данные документов хранятся столбцами по ordinal. Внешние id отображаются на ordinal хеш-таблицей
+    // документов, добавленных после последнего уплотнения, и двоичным поиском по упорядоченным столбцам
+    // остальных: столбцы могут ссылаться на файл индекса, и при открытии таблица не строится.
+    // Удаление не сдвигает столбцы: удалённый документ остаётся в них, пока его ordinal не станет
+    // мёртвым (IsLiveOrdinal), и вычищается пакетным уплотнением.
+    Column<int> document_ids_;  // упорядоченные внешние id, в том числе удалённых документов
+    Column<int> document_id_ordinals_;  // ordinal документа document_ids_[i]
+    std::unordered_map<int, int> added_document_ordinals_;  // id -> ordinal документов вне document_ids_
+    size_t removed_id_count_ = 0;  // удалённых документов в document_ids_
+    Column<int> ordinal_to_document_id_;
+    Column<int> ratings_;
+    Column<DocumentStatus> statuses_;
+    // по битовой карте на статус: отмечены ordinal живых документов с этим статусом
+    std::array<DynamicBitset, DOCUMENT_STATUS_COUNT> status_documents_;
+    RaggedColumn<char> texts_;
+    // прямой индекс: для каждого ordinal пары (id терма, tf), упорядоченные по id терма
+    RaggedColumn<TermFreq> doc_id_to_words_freqs_;
+    // обратный индекс: постинги терма (ordinal, tf) по сегментам
+    SegmentedIndex index_;
+    // число документов с термом, по id терма; поддерживается при добавлении и удалении
+    Column<int> term_document_counts_;
+    uint64_t index_generation_ = 0;
+    mutable InverseDocumentFreqCache inverse_document_freqs_;
+    mutable QueryCache<Query> search_queries_;
+
+    RetrievalAlgorithm retrieval_algorithm_ = RetrievalAlgorithm::EXHAUSTIVE;
 
     bool IsStopWord(const std::string_view word) const;
 
@@ -117,7 +277,8 @@ private:
         return rating_sum / static_cast<int>(ratings.size());
     }
 
-    QueryWord ParseQueryWord(const std::string_view text) const;
+    // is_valid — нет ли в слове управляющих символов; проверяется при разбиении запроса на слова
+    QueryWord ParseQueryWord(const std::string_view text, bool is_valid) const;
 
     Query ParseQuery(const std::string_view text) const;
     Query ParseQuery(const std::execution::sequenced_policy& policy, const std::string_view text) const;
@@ -126,7 +287,61 @@ private:
     template<typename ExecutionPolicy>
     Query ParseQuery(const ExecutionPolicy&& exec_policy, const std::string_view text) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+
+    int FindOrdinal(int document_id) const;
+
+    template <typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy* policy, const std::vector<NewDocument>& documents);
+
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(const ExecutionPolicy* policy, const std::vector<int>& document_ids);
+
+    int AppendDocumentRecord(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void EraseDocumentRecord(int document_id, int ordinal);
+
+    void ReleaseDocumentRow(int ordinal);
+
+    // Документ жив, пока отмечен в карте своего статуса: ReleaseDocumentRow снимает отметки во всех картах
+    bool IsLiveOrdinal(int ordinal) const;
+
+    // ordinal документа document_ids_[position]; из файла индекса он проверяется при чтении
+    int GetIdColumnOrdinal(size_t position) const;
+
+    // Считает удалённым документ из document_ids_ и уплотняет столбцы по правилу PurgeSegments:
+    // когда удалена четверть. Так удаление стоит O(1) амортизированно
+    void CountRemovedId();
+
+    // Столбцы id и ordinal живых документов по возрастанию id — из упорядоченных столбцов и хеш-таблицы
+    std::pair<std::vector<int>, std::vector<int>> CollectDocumentIds() const;
+
+    // Переносит добавленные документы из хеш-таблицы в упорядоченные столбцы и выбрасывает удалённые
+    void CompactDocumentIds();
+
+    // Строка прямого индекса с проверкой id термов: строки из файла индекса проверяются при чтении
+    ColumnRow<TermFreq> GetDocumentTerms(int ordinal) const;
+
+    size_t GetTermDocumentCount(TermId term_id) const;
+
+    // Сервер поверх секций файла индекса; столбцы ссылаются на память file
+    static SearchServer FromIndexFile(const IndexFile& file);
+
+    // Разбирает запрос для поиска и берёт IDF плюс-слов из inverse_document_freq(term_id)
+    template <typename InverseDocumentFreq>
+    Query ParseSearchQuery(std::string_view raw_query, InverseDocumentFreq inverse_document_freq) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByQuery(ExecutionPolicy&& exec_policy, const Query& query, DocumentPredicate document_predicate, size_t top_k) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsWand(const Query& query, DocumentPredicate document_predicate, size_t top_k, bool use_block_max) const;
+
+    static bool ContainsTerm(ColumnRow<TermFreq> term_freqs, TermId term_id) {
+        const auto it = std::lower_bound(term_freqs.begin(), term_freqs.end(), term_id,
+            [](const TermFreq& term_freq, TermId id) { return term_freq.term_id < id; });
+        return it != term_freqs.end() && it->term_id == term_id;
+    }
 
     template <typename ExecutionPolicy, class DocumentPredicate>
     std::vector<Document> FindAllDocuments(ExecutionPolicy&& exec_policy, const Query& query, DocumentPredicate document_predicate) const;
@@ -134,30 +349,37 @@ private:
 
 template<typename ExecutionPolicy>
 inline SearchServer::MatchDocumentResult SearchServer::MatchDocument(const ExecutionPolicy&& exec_policy, const std::string_view raw_query, int document_id) const {
-    if (!document_ids_.count(document_id)) {
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal == NO_ORDINAL) {
         using namespace std::literals::string_literals;
         throw std::out_of_range("document_id incorrect!"s);
     }
-    const auto query = std::move(ParseQuery(*exec_policy, raw_query));
+    const auto query = ParseQuery(*exec_policy, raw_query);
+    const ColumnRow<TermFreq> term_freqs = doc_id_to_words_freqs_.GetRow(ordinal);
 
-    if (std::any_of(*exec_policy, std::make_move_iterator(query.minus_words.begin()), std::make_move_iterator(query.minus_words.end()),
-        [this, document_id](const auto& word) {
-            return doc_id_to_words_freqs_.at(document_id).count(word);
+    if (std::any_of(*exec_policy, query.minus_words.begin(), query.minus_words.end(),
+        [&term_freqs](TermId term_id) {
+            return ContainsTerm(term_freqs, term_id);
         })) {
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, statuses_[ordinal] };
     }
 
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto last = std::copy_if(*exec_policy, std::make_move_iterator(query.plus_words.begin()), std::make_move_iterator(query.plus_words.end()),
-        matched_words.begin(),
-        [this, document_id](const auto& word) {
-            return doc_id_to_words_freqs_.at(document_id).count(word);
+    std::vector<TermId> matched_terms(query.plus_words.size());
+    auto last = std::copy_if(*exec_policy, query.plus_words.begin(), query.plus_words.end(),
+        matched_terms.begin(),
+        [&term_freqs](TermId term_id) {
+            return ContainsTerm(term_freqs, term_id);
         });
-    std::sort(*exec_policy, matched_words.begin(), last);
-    auto it = std::unique(*exec_policy, matched_words.begin(), last);
-    matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    // string_view указывают в словарь, а не в строку запроса, поэтому переживают вызов
+    std::vector<std::string_view> matched_words(last - matched_terms.begin());
+    std::transform(*exec_policy, matched_terms.begin(), last, matched_words.begin(),
+        [this](TermId term_id) {
+            return terms_.GetWord(term_id);
+        });
+    std::sort(*exec_policy, matched_words.begin(), matched_words.end());
+
+    return { matched_words, statuses_[ordinal] };
 }
 
 template<typename ExecutionPolicy>
@@ -165,19 +387,22 @@ inline SearchServer::Query SearchServer::ParseQuery(const ExecutionPolicy&& exec
 
     Query result;
 
-    std::vector<std::string_view> words = SplitIntoWords(text);
-    result.minus_words.reserve(words.size());
-    result.plus_words.reserve(words.size());
-
-    for (const auto& word : words) {
-        const auto& query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
+    // слова перебираются без промежуточного вектора; разбор прерывается исключением на первом некорректном
+    const WordRange words(text);
+    for (auto it = words.begin(); it != words.end(); ++it) {
+        const auto& query_word = ParseQueryWord(*it, it.IsValid());
+        if (query_word.is_stop) {
+            continue;
+        }
+        const TermId term_id = terms_.Find(query_word.data);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            result.minus_words.push_back(term_id);
+        }
+        else {
+            result.plus_words.push_back(term_id);
         }
     }
 
@@ -195,15 +420,17 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
 {
     using namespace std::literals::string_literals;
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-        throw std::invalid_argument("Some of stop words are invalid"s);
+    for (size_t i = 0; i < stop_words_.Size(); ++i) {
+        if (!IsValidWord(stop_words_.GetWord(i))) {
+            throw std::invalid_argument("Some of stop words are invalid"s);
+        }
     }
 }
 
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
 }
 
 template <typename ExecutionPolicy>
@@ -212,74 +439,267 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& exec_poli
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(exec_policy, raw_query, [&status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status; });
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(exec_policy, raw_query, StatusPredicate{ status }, top_k);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+    const auto query = search_queries_.Get(raw_query, index_generation_, [this](std::string_view text) {
+        return ParseSearchQuery(text, [this](TermId term_id) {
+            return ComputeWordInverseDocumentFreq(term_id);
+            });
+        });
+    return FindTopDocumentsByQuery(exec_policy, *query, document_predicate, top_k);
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& exec_policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k,
+    const WordInverseDocumentFreqs& inverse_document_freqs) const {
+    const Query query = ParseSearchQuery(raw_query, [this, &inverse_document_freqs](TermId term_id) {
+        const auto it = inverse_document_freqs.find(terms_.GetWord(term_id));
+        return it == inverse_document_freqs.end() ? 0.0 : it->second;
+        });
+    return FindTopDocumentsByQuery(exec_policy, query, document_predicate, top_k);
+}
 
+template <typename InverseDocumentFreq>
+SearchServer::Query SearchServer::ParseSearchQuery(std::string_view raw_query, InverseDocumentFreq inverse_document_freq) const {
+    // слова уже упорядочены и без повторов: это делает ParseQuery
     auto query = ParseQuery(raw_query);
 
-    std::sort(query.plus_words.begin(), query.plus_words.end());
-    query.plus_words.erase(std::unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
+    query.inverse_document_freqs.resize(query.plus_words.size());
+    std::transform(query.plus_words.begin(), query.plus_words.end(), query.inverse_document_freqs.begin(), inverse_document_freq);
+    return query;
+}
 
-    std::sort(query.minus_words.begin(), query.minus_words.end());
-    query.minus_words.erase(std::unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByQuery(ExecutionPolicy&& exec_policy, const Query& query, DocumentPredicate document_predicate, size_t top_k) const {
+    if (retrieval_algorithm_ != RetrievalAlgorithm::EXHAUSTIVE) {
+        return FindTopDocumentsWand(query, document_predicate, top_k, retrieval_algorithm_ == RetrievalAlgorithm::BLOCK_MAX_WAND);
+    }
 
     auto matched_documents = FindAllDocuments(exec_policy, query, document_predicate);
 
-    std::sort(exec_policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    // частичный отбор через ограниченную кучу вместо полной сортировки всех найденных документов
+    return SelectTopK(exec_policy, std::move(matched_documents), top_k, IsMoreRelevant);
 }
 
 
 template <typename ExecutionPolicy, class DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& exec_policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(6);
-
-    const auto plus_word_checker =
-        [this, &document_predicate, &document_to_relevance](std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += static_cast<double>(term_freq * inverse_document_freq);
+    const int ordinal_count = static_cast<int>(ordinal_to_document_id_.Size());
+    const SegmentedIndex::Snapshot index = index_.GetSnapshot();
+
+    // документы с минус-словами отмечаются до подсчёта, и их релевантность не накапливается вовсе.
+    // Для запроса по статусу вместо этого берётся битовая карта статуса, из которой они вычёркиваются.
+    constexpr bool is_status_query = std::is_same_v<std::decay_t<DocumentPredicate>, StatusPredicate>;
+    const bool has_minus_words = !query.minus_words.empty();
+    DynamicBitset excluded_documents;
+    DynamicBitset allowed_documents;
+    const DynamicBitset* status_documents = nullptr;
+    if constexpr (is_status_query) {
+        status_documents = &status_documents_[static_cast<int>(document_predicate.status)];
+        if (has_minus_words) {
+            allowed_documents = *status_documents;
+            for (const TermId term_id : query.minus_words) {
+                index.ForEachPosting(term_id, [&allowed_documents](int ordinal, double) {
+                    allowed_documents.Reset(ordinal);
+                    });
             }
+            status_documents = &allowed_documents;
+        }
+    }
+    else if (has_minus_words) {
+        excluded_documents.Resize(ordinal_count);
+        for (const TermId term_id : query.minus_words) {
+            index.ForEachPosting(term_id, [&excluded_documents](int ordinal, double) {
+                excluded_documents.Set(ordinal);
+                });
+        }
+    }
+    // удалённые документы уже вычеркнуты из битовых карт статусов, а для прочих условий проверяются явно
+    const auto is_candidate = [&](int ordinal) {
+        if constexpr (is_status_query) {
+            return status_documents->Test(ordinal);
+        }
+        else {
+            return !(has_minus_words && excluded_documents.Test(ordinal)) && !index.IsRemoved(ordinal)
+                && document_predicate(ordinal_to_document_id_[ordinal], statuses_[ordinal], ratings_[ordinal]);
         }
     };
-    std::for_each(exec_policy, query.plus_words.begin(), query.plus_words.end(), plus_word_checker);
 
-    const auto minus_word_checker =
-        [this, &document_predicate, &document_to_relevance](std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+    // слова запроса делятся на части, каждая набирает релевантности в собственный накопитель без блокировок
+    constexpr bool is_sequenced = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+    const size_t chunk_count = is_sequenced ? 1
+        : std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), query.plus_words.size()));
+    const size_t chunk_size = (query.plus_words.size() + chunk_count - 1) / chunk_count;
+    std::vector<ScoreAccumulator> accumulators(chunk_count);
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+
+    if constexpr (!is_sequenced) {
+        for (const TermId term_id : query.plus_words) {
+            index.CheckPostings(term_id);
+        }
+    }
+
+    const auto plus_word_checker =
+        [this, &index, &query, &accumulators, &is_candidate, ordinal_count, chunk_size](size_t chunk) {
+        const auto first = query.plus_words.begin() + std::min(query.plus_words.size(), chunk * chunk_size);
+        const auto last = query.plus_words.begin() + std::min(query.plus_words.size(), (chunk + 1) * chunk_size);
+        // число постингов — оценка сверху числа документов, по ней выбирается вид накопителя
+        size_t posting_count = 0;
+        for (auto it = first; it != last; ++it) {
+            posting_count += GetTermDocumentCount(*it);
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.Erase(document_id);
+        ScoreAccumulator& document_to_relevance = accumulators[chunk];
+        document_to_relevance = ScoreAccumulator(ordinal_count, posting_count);
+        for (auto it = first; it != last; ++it) {
+            if (GetTermDocumentCount(*it) == 0) {
+                continue;
+            }
+            const double inverse_document_freq = query.inverse_document_freqs[it - query.plus_words.begin()];
+            index.ForEachPosting(*it, [&](int ordinal, double term_freq) {
+                if (is_candidate(ordinal)) {
+                    document_to_relevance.Add(ordinal, term_freq * inverse_document_freq);
+                }
+                });
         }
     };
-    std::for_each(exec_policy, query.minus_words.begin(), query.minus_words.end(), minus_word_checker);
+    std::for_each(exec_policy, chunks.begin(), chunks.end(), plus_word_checker);
 
-    std::map<int, double> m_doc_to_relevance = document_to_relevance.BuildOrdinaryMap();
+    ScoreAccumulator& document_to_relevance = accumulators.front();
+    for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+        document_to_relevance.Merge(accumulators[chunk]);
+    }
 
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : m_doc_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    for (const auto& [ordinal, relevance] : document_to_relevance.Extract()) {
+        matched_documents.push_back({ ordinal_to_document_id_[ordinal], relevance, ratings_[ordinal] });
     }
     return matched_documents;
-}
\ No newline at end of file
+}
+
+// Обход документ за документом (WAND). Курсоры упорядочиваются по текущему документу, и первый
+// документ, на котором сумма верхних оценок курсоров превышает порог выдачи, становится опорным.
+// Документы левее опорного пропускаются без подсчёта релевантности. Порог учитывает EPSILON,
+// с которым сравниваются релевантности, поэтому выдача совпадает с полным перебором.
+// С use_block_max опорный документ сначала проверяется по максимумам tf текущих блоков курсоров:
+// если даже они не дают превысить порог, пропускается весь диапазон до конца ближайшего блока.
+// Обход последовательный при любой политике выполнения.
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsWand(const Query& query, DocumentPredicate document_predicate, size_t top_k, bool use_block_max) const {
+    if (top_k == 0) {
+        return {};
+    }
+    struct TermCursor {
+        PostingCursor cursor;
+        double inverse_document_freq;
+        double upper_bound;
+    };
+
+    // IDF относится ко всему индексу, а курсоры строятся по очереди в каждом сегменте.
+    // Порог выдачи переходит из сегмента в сегмент, поэтому последующие сегменты отсеиваются сильнее.
+    std::vector<std::pair<TermId, double>> plus_terms;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (GetTermDocumentCount(query.plus_words[i]) > 0) {
+            plus_terms.emplace_back(query.plus_words[i], query.inverse_document_freqs[i]);
+        }
+    }
+    const SegmentedIndex::Snapshot index = index_.GetSnapshot();
+
+    TopKCollector<Document, decltype(&IsMoreRelevant)> top_documents(top_k, IsMoreRelevant);
+    double threshold = -std::numeric_limits<double>::infinity();
+    std::vector<TermCursor> terms;
+    std::vector<PostingCursor> minus_cursors;
+    std::vector<TermCursor*> order;
+    for (size_t segment = 0; segment < index.GetSegmentCount(); ++segment) {
+        // курсоры идут в порядке слов запроса: в нём же суммируется релевантность, как и при полном переборе
+        terms.clear();
+        for (const auto& [term_id, inverse_document_freq] : plus_terms) {
+            PostingCursor cursor = index.MakePostingCursor(segment, term_id);
+            if (cursor.GetDocument() != PostingCursor::END) {
+                // небольшой запас защищает от ошибок округления при сравнении с порогом
+                terms.push_back({ cursor, inverse_document_freq, index.GetMaxTermFreq(segment, term_id) * inverse_document_freq + 1e-12 });
+            }
+        }
+        minus_cursors.clear();
+        for (const TermId term_id : query.minus_words) {
+            minus_cursors.push_back(index.MakePostingCursor(segment, term_id));
+        }
+        order.resize(terms.size());
+        std::transform(terms.begin(), terms.end(), order.begin(), [](TermCursor& term) { return &term; });
+
+        while (true) {
+            std::sort(order.begin(), order.end(), [](const TermCursor* lhs, const TermCursor* rhs) {
+                return lhs->cursor.GetDocument() < rhs->cursor.GetDocument();
+                });
+
+            size_t pivot = order.size();
+            double score_bound = 0.0;
+            for (size_t i = 0; i < order.size() && order[i]->cursor.GetDocument() != PostingCursor::END; ++i) {
+                score_bound += order[i]->upper_bound;
+                if (score_bound > threshold) {
+                    pivot = i;
+                    break;
+                }
+            }
+            if (pivot == order.size()) {
+                break;
+            }
+
+            const int pivot_ordinal = order[pivot]->cursor.GetDocument();
+            if (use_block_max) {
+                // в оценку входят все курсоры, стоящие на опорном документе
+                while (pivot + 1 < order.size() && order[pivot + 1]->cursor.GetDocument() == pivot_ordinal) {
+                    ++pivot;
+                }
+                int skip_ordinal = pivot + 1 < order.size() ? order[pivot + 1]->cursor.GetDocument() : PostingCursor::END;
+                double block_bound = 0.0;
+                for (size_t i = 0; i <= pivot; ++i) {
+                    const PostingCursor::BlockBound bound = order[i]->cursor.GetBlockBound(pivot_ordinal);
+                    block_bound += bound.max_term_freq * order[i]->inverse_document_freq + 1e-12;
+                    if (bound.last_document != PostingCursor::END) {
+                        skip_ordinal = std::min(skip_ordinal, bound.last_document + 1);
+                    }
+                }
+                if (block_bound <= threshold) {
+                    // до skip_ordinal ни один документ не наберёт релевантность выше порога
+                    for (size_t i = 0; i <= pivot; ++i) {
+                        order[i]->cursor.Advance(skip_ordinal);
+                    }
+                    continue;
+                }
+            }
+            if (order.front()->cursor.GetDocument() != pivot_ordinal) {
+                order.front()->cursor.Advance(pivot_ordinal);
+                continue;
+            }
+
+            const bool is_excluded = std::any_of(minus_cursors.begin(), minus_cursors.end(), [pivot_ordinal](PostingCursor& cursor) {
+                cursor.Advance(pivot_ordinal);
+                return cursor.GetDocument() == pivot_ordinal;
+                });
+            if (!is_excluded && !index.IsRemoved(pivot_ordinal) && document_predicate(ordinal_to_document_id_[pivot_ordinal], statuses_[pivot_ordinal], ratings_[pivot_ordinal])) {
+                double relevance = 0.0;
+                for (const TermCursor& term : terms) {
+                    if (term.cursor.GetDocument() == pivot_ordinal) {
+                        relevance += term.cursor.GetTermFreq() * term.inverse_document_freq;
+                    }
+                }
+                top_documents.Push({ ordinal_to_document_id_[pivot_ordinal], relevance, ratings_[pivot_ordinal] });
+                if (top_documents.IsFull()) {
+                    // документ может обойти худший отобранный, только если его релевантность выше этой границы
+                    threshold = top_documents.GetWorst().relevance - EPSILON;
+                }
+            }
+            for (TermCursor& term : terms) {
+                if (term.cursor.GetDocument() == pivot_ordinal) {
+                    term.cursor.Next();
+                }
+            }
+        }
+    }
+    return top_documents.Extract();
+}
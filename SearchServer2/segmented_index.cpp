@@ -0,0 +1,311 @@
+﻿#include "segmented_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+PostingCursor SegmentedIndex::Snapshot::MakePostingCursor(size_t segment, TermId term_id) const {
+    if (segment < sealed_segments_->size()) {
+        return PostingCursor((*sealed_segments_)[segment]->postings.GetTermPostings(term_id));
+    }
+    static const std::map<int, double> no_postings;
+    if (term_id >= index_->mutable_postings_.size()) {
+        return PostingCursor(no_postings, 0.0);
+    }
+    return PostingCursor(index_->mutable_postings_[term_id], index_->mutable_max_term_freqs_[term_id]);
+}
+
+double SegmentedIndex::Snapshot::GetMaxTermFreq(size_t segment, TermId term_id) const {
+    // запечатанные сегменты знают точные максимумы, изменяемый — только верхнюю границу
+    if (segment < sealed_segments_->size()) {
+        return (*sealed_segments_)[segment]->postings.GetTermPostings(term_id).max_term_freq;
+    }
+    return term_id < index_->mutable_max_term_freqs_.size() ? index_->mutable_max_term_freqs_[term_id] : 0.0;
+}
+
+void SegmentedIndex::Snapshot::CheckPostings(TermId term_id) const {
+    for (const auto& segment : *sealed_segments_) {
+        segment->postings.GetTermPostings(term_id);
+    }
+}
+
+SegmentedIndex::SegmentedIndex(const SegmentedIndex& other)
+    : mutable_postings_(other.mutable_postings_)
+    , mutable_max_term_freqs_(other.mutable_max_term_freqs_)
+    , mutable_first_ordinal_(other.mutable_first_ordinal_)
+    , end_ordinal_(other.end_ordinal_)
+    , segment_document_limit_(other.segment_document_limit_.load())
+    , removed_documents_(other.CopyRemovedDocuments())
+    , sealed_segments_(std::atomic_load(&other.sealed_segments_)) {
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    {
+        std::lock_guard guard(segments_mutex_);
+        stop_merging_ = true;
+    }
+    merge_condition_.notify_one();
+    if (merge_thread_.joinable()) {
+        merge_thread_.join();
+    }
+}
+
+void SegmentedIndex::SetSegmentDocumentLimit(size_t limit) {
+    segment_document_limit_ = std::max<size_t>(limit, 1);
+}
+
+size_t SegmentedIndex::GetSegmentDocumentLimit() const {
+    return segment_document_limit_;
+}
+
+SegmentedIndex::Snapshot SegmentedIndex::GetSnapshot() const {
+    Snapshot snapshot;
+    snapshot.index_ = this;
+    snapshot.sealed_segments_ = std::atomic_load(&sealed_segments_);
+    return snapshot;
+}
+
+size_t SegmentedIndex::GetSegmentCount() const {
+    return std::atomic_load(&sealed_segments_)->size() + 1;
+}
+
+void SegmentedIndex::ReserveTerms(size_t term_count) {
+    if (term_count > mutable_postings_.size()) {
+        mutable_postings_.resize(term_count);
+        mutable_max_term_freqs_.resize(term_count);
+    }
+}
+
+void SegmentedIndex::AddPosting(TermId term_id, int ordinal, double term_freq) {
+    auto& document_freqs = mutable_postings_[term_id];
+    // ordinal растут, поэтому вставка с подсказкой в конец — амортизированно O(1)
+    document_freqs.emplace_hint(document_freqs.end(), ordinal, term_freq);
+    mutable_max_term_freqs_[term_id] = std::max(mutable_max_term_freqs_[term_id], term_freq);
+}
+
+void SegmentedIndex::FinishDocuments(int end_ordinal) {
+    end_ordinal_ = end_ordinal;
+    {
+        std::lock_guard guard(removed_documents_mutex_);
+        removed_documents_.Resize(end_ordinal_);
+    }
+    if (static_cast<size_t>(end_ordinal_ - mutable_first_ordinal_) >= segment_document_limit_) {
+        Seal();
+    }
+}
+
+void SegmentedIndex::RemoveDocument(int ordinal) {
+    bool purge = false;
+    {
+        std::lock_guard guard(removed_documents_mutex_);
+        purge = MarkRemoved(ordinal);
+    }
+    if (purge) {
+        RequestPurge();
+    }
+}
+
+void SegmentedIndex::RemoveDocuments(const std::vector<int>& ordinals) {
+    bool purge = false;
+    {
+        std::lock_guard guard(removed_documents_mutex_);
+        for (const int ordinal : ordinals) {
+            purge = MarkRemoved(ordinal) || purge;
+        }
+    }
+    if (purge) {
+        RequestPurge();
+    }
+}
+
+// Изменяемый сегмент вычищается при запечатывании, запечатанные — фоновой пересборкой,
+// которая будится раз в segment_document_limit_ удалений
+bool SegmentedIndex::MarkRemoved(int ordinal) {
+    removed_documents_.Set(ordinal);
+    if (ordinal >= mutable_first_ordinal_ || ++pending_removal_count_ < segment_document_limit_) {
+        return false;
+    }
+    pending_removal_count_ = 0;
+    return true;
+}
+
+void SegmentedIndex::RequestPurge() {
+    {
+        std::lock_guard guard(segments_mutex_);
+        purge_requested_ = true;
+    }
+    merge_condition_.notify_one();
+}
+
+DynamicBitset SegmentedIndex::CopyRemovedDocuments() const {
+    std::lock_guard guard(removed_documents_mutex_);
+    return removed_documents_;
+}
+
+void SegmentedIndex::Compact() {
+    if (end_ordinal_ > mutable_first_ordinal_) {
+        Seal();
+    }
+    std::lock_guard merge_guard(merge_mutex_);
+    const size_t segment_count = std::atomic_load(&sealed_segments_)->size();
+    // слияние даже одного сегмента вычищает из него удалённые документы
+    if (segment_count > 0) {
+        MergeSegments(0, segment_count);
+    }
+}
+
+bool SegmentedIndex::IsCompact() const {
+    return end_ordinal_ == mutable_first_ordinal_ && std::atomic_load(&sealed_segments_)->size() <= 1;
+}
+
+FrozenIndex SegmentedIndex::BuildCompactIndex() const {
+    const auto segments = std::atomic_load(&sealed_segments_);
+    const DynamicBitset removed_documents = CopyRemovedDocuments();
+    const FrozenIndex mutable_segment(mutable_postings_, removed_documents);
+    std::vector<const FrozenIndex*> indexes;
+    for (const auto& segment : *segments) {
+        indexes.push_back(&segment->postings);
+    }
+    indexes.push_back(&mutable_segment);
+    return FrozenIndex::Merge(indexes, removed_documents);
+}
+
+void SegmentedIndex::Load(FrozenIndex postings, int end_ordinal) {
+    auto segment = std::make_shared<Segment>(Segment{ 0, end_ordinal, 0, std::move(postings) });
+    mutable_first_ordinal_ = end_ordinal;
+    end_ordinal_ = end_ordinal;
+    {
+        std::lock_guard guard(removed_documents_mutex_);
+        removed_documents_.Resize(end_ordinal);
+    }
+    std::lock_guard guard(segments_mutex_);
+    PublishSegments(SegmentList{ std::move(segment) });
+}
+
+void SegmentedIndex::Seal() {
+    const DynamicBitset removed_documents = CopyRemovedDocuments();
+    auto segment = std::make_shared<Segment>(Segment{ mutable_first_ordinal_, end_ordinal_,
+        removed_documents.Count(mutable_first_ordinal_, end_ordinal_), FrozenIndex(mutable_postings_, removed_documents) });
+    const size_t term_count = mutable_postings_.size();
+    std::vector<std::map<int, double>>(term_count).swap(mutable_postings_);
+    mutable_max_term_freqs_.assign(term_count, 0.0);
+    mutable_first_ordinal_ = end_ordinal_;
+    {
+        std::lock_guard guard(segments_mutex_);
+        SegmentList segments = *sealed_segments_;
+        segments.push_back(std::move(segment));
+        PublishSegments(std::move(segments));
+        StartMergeThread();
+    }
+    merge_condition_.notify_one();
+}
+
+// Вызывается под segments_mutex_
+void SegmentedIndex::StartMergeThread() {
+    if (!merge_thread_.joinable()) {
+        merge_thread_ = std::thread(&SegmentedIndex::RunMerges, this);
+    }
+}
+
+void SegmentedIndex::PurgeSegments() {
+    const auto segments = std::atomic_load(&sealed_segments_);
+    const DynamicBitset removed_documents = CopyRemovedDocuments();
+    for (size_t position = 0; position < segments->size(); ++position) {
+        const Segment& segment = *(*segments)[position];
+        const size_t removed_count = removed_documents.Count(segment.first_ordinal, segment.end_ordinal);
+        if ((removed_count - segment.purged_count) * 4 < static_cast<size_t>(segment.end_ordinal - segment.first_ordinal)) {
+            continue;
+        }
+        auto purged = std::make_shared<Segment>(Segment{ segment.first_ordinal, segment.end_ordinal, removed_count,
+            segment.postings.WithoutDocuments(removed_documents) });
+        std::lock_guard guard(segments_mutex_);
+        SegmentList updated = *sealed_segments_;
+        updated[position] = std::move(purged);
+        PublishSegments(std::move(updated));
+    }
+}
+
+// Уровень сегмента — целая часть логарифма его размера в лимитах по основанию MERGE_FACTOR.
+// Сливаются первые MERGE_FACTOR соседних сегментов одного уровня.
+std::pair<size_t, size_t> SegmentedIndex::FindMergeRange(const SegmentList& segments) const {
+    const auto get_level = [this](const Segment& segment) {
+        size_t level = 0;
+        size_t size = static_cast<size_t>(segment.end_ordinal - segment.first_ordinal) / segment_document_limit_;
+        while (size >= MERGE_FACTOR) {
+            size /= MERGE_FACTOR;
+            ++level;
+        }
+        return level;
+    };
+    size_t run_start = 0;
+    for (size_t i = 1; i <= segments.size(); ++i) {
+        if (i == segments.size() || get_level(*segments[i]) != get_level(*segments[run_start])) {
+            run_start = i;
+            continue;
+        }
+        if (i + 1 - run_start == MERGE_FACTOR) {
+            return { run_start, i + 1 };
+        }
+    }
+    return { 0, 0 };
+}
+
+void SegmentedIndex::MergeSegments(size_t first, size_t last) {
+    const auto segments = std::atomic_load(&sealed_segments_);
+    const SegmentList parts(segments->begin() + first, segments->begin() + last);
+    // сегменты неизменяемы, поэтому слияние идёт без блокировки списка
+    std::vector<const FrozenIndex*> indexes;
+    for (const auto& part : parts) {
+        indexes.push_back(&part->postings);
+    }
+    const DynamicBitset removed_documents = CopyRemovedDocuments();
+    const int first_ordinal = parts.front()->first_ordinal;
+    const int end_ordinal = parts.back()->end_ordinal;
+    auto merged = std::make_shared<Segment>(Segment{ first_ordinal, end_ordinal,
+        removed_documents.Count(first_ordinal, end_ordinal), FrozenIndex::Merge(indexes, removed_documents) });
+
+    std::lock_guard guard(segments_mutex_);
+    SegmentList updated = *sealed_segments_;
+    updated[first] = std::move(merged);
+    updated.erase(updated.begin() + first + 1, updated.begin() + last);
+    PublishSegments(std::move(updated));
+}
+
+void SegmentedIndex::PublishSegments(SegmentList segments) {
+    std::atomic_store(&sealed_segments_, std::make_shared<const SegmentList>(std::move(segments)));
+}
+
+void SegmentedIndex::RunMerges() {
+    while (true) {
+        bool purge = false;
+        {
+            std::unique_lock lock(segments_mutex_);
+            merge_condition_.wait(lock, [this] {
+                return stop_merging_ || purge_requested_ || FindMergeRange(*sealed_segments_).second > 0;
+                });
+            if (stop_merging_) {
+                return;
+            }
+            purge = purge_requested_;
+            purge_requested_ = false;
+        }
+        std::lock_guard merge_guard(merge_mutex_);
+        // повреждённые постинги файла индекса обнаруживаются только при чтении (см. FrozenIndex::Open):
+        // фоновые слияния тогда прекращаются, а ошибку получают запросы и Compact, читающие эти постинги
+        try {
+            if (purge) {
+                PurgeSegments();
+            }
+            std::pair<size_t, size_t> range;
+            {
+                std::lock_guard guard(segments_mutex_);
+                range = FindMergeRange(*sealed_segments_);
+            }
+            if (range.second > 0) {
+                MergeSegments(range.first, range.second);
+            }
+        }
+        catch (const std::runtime_error&) {
+            return;
+        }
+    }
+}
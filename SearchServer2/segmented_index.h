@@ -0,0 +1,193 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "dynamic_bitset.h"
+#include "frozen_index.h"
+#include "posting_cursor.h"
+#include "term_dictionary.h"
+
+// Обратный индекс из сегментов по образцу LSM-дерева. Новые документы попадают в изменяемый сегмент
+// (std::map на терм); когда в нём набирается заданное число документов, он запечатывается в сжатый
+// FrozenIndex. Фоновый поток сливает соседние запечатанные сегменты одного уровня в более крупные,
+// поэтому их число растёт логарифмически. Документы адресуются ordinal, которые только растут,
+// так что сегменты покрывают непересекающиеся возрастающие диапазоны ordinal.
+//
+// Удаление логическое: документ отмечается в битовой карте удалённых и сразу пропускается запросами,
+// а его постинги физически вычищаются позже — при запечатывании и слиянии сегментов или фоновой
+// пересборкой сегмента, в котором накопилось много удалённых документов.
+//
+// Изменения выполняет один пишущий поток, не одновременно с запросами. Фоновое слияние идёт параллельно
+// и с запросами, и с изменениями: запрос работает со снимком списка сегментов и слиянию не мешает.
+class SegmentedIndex {
+public:
+    static constexpr size_t DEFAULT_SEGMENT_DOCUMENT_LIMIT = 8192;
+    // Столько соседних сегментов одного уровня сливаются в один сегмент следующего уровня
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    // Запечатанный сегмент: постинги документов с ordinal из [first_ordinal, end_ordinal).
+    // purged_count — сколько документов диапазона было удалено к моменту сборки сегмента.
+    struct Segment {
+        int first_ordinal = 0;
+        int end_ordinal = 0;
+        size_t purged_count = 0;
+        FrozenIndex postings;
+    };
+
+    // Запечатанные сегменты по возрастанию ordinal. Опубликованный список не меняется: запечатывание,
+    // слияние и пересборка публикуют новый, поэтому запрос берёт его одним атомарным чтением
+    // shared_ptr, не копируя список и не занимая segments_mutex_.
+    using SegmentList = std::vector<std::shared_ptr<const Segment>>;
+
+    // Индекс глазами одного запроса: запечатанные сегменты по возрастанию ordinal, изменяемый — последним
+    class Snapshot {
+    public:
+        size_t GetSegmentCount() const {
+            return sealed_segments_->size() + 1;
+        }
+
+        // Обходит постинги терма во всех сегментах по возрастанию ordinal
+        template <typename Callback>
+        void ForEachPosting(TermId term_id, Callback callback) const;
+
+        PostingCursor MakePostingCursor(size_t segment, TermId term_id) const;
+
+        // Верхняя граница tf терма в сегменте
+        double GetMaxTermFreq(size_t segment, TermId term_id) const;
+
+        // Проверяет постинги терма, открытые из файла индекса (см. FrozenIndex::Open), не обходя их.
+        // Вызывается перед параллельным обходом: исключение изнутри него завершило бы программу.
+        void CheckPostings(TermId term_id) const;
+
+        // Постинги удалённого документа могут ещё оставаться в сегментах, их нужно пропускать
+        bool IsRemoved(int ordinal) const {
+            return index_->removed_documents_.Test(ordinal);
+        }
+
+    private:
+        friend class SegmentedIndex;
+
+        std::shared_ptr<const SegmentList> sealed_segments_;
+        const SegmentedIndex* index_ = nullptr;
+    };
+
+    SegmentedIndex() = default;
+
+    // Копия разделяет с оригиналом неизменяемые сегменты; фоновый поток у неё свой и запускается по мере надобности
+    SegmentedIndex(const SegmentedIndex& other);
+
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    ~SegmentedIndex();
+
+    void SetSegmentDocumentLimit(size_t limit);
+
+    size_t GetSegmentDocumentLimit() const;
+
+    Snapshot GetSnapshot() const;
+
+    // Число сегментов, включая изменяемый
+    size_t GetSegmentCount() const;
+
+    // Готовит изменяемый сегмент к термам с id меньше term_count
+    void ReserveTerms(size_t term_count);
+
+    // Дописывает постинг в изменяемый сегмент. Документы добавляются по возрастанию ordinal;
+    // постинги разных термов можно дописывать из разных потоков.
+    void AddPosting(TermId term_id, int ordinal, double term_freq);
+
+    // Документы с ordinal меньше end_ordinal добавлены целиком. Переполненный изменяемый сегмент запечатывается.
+    void FinishDocuments(int end_ordinal);
+
+    // Логически удаляет документ за O(1); постинги вычищаются позже
+    void RemoveDocument(int ordinal);
+
+    // То же для пакета: карта удалённых блокируется и фоновый поток будится не больше одного раза
+    void RemoveDocuments(const std::vector<int>& ordinals);
+
+    // Запечатывает изменяемый сегмент и сливает все сегменты в один, вычищая удалённые документы
+    void Compact();
+
+    // true, если все документы лежат в одном запечатанном сегменте
+    bool IsCompact() const;
+
+    // Постинги всех сегментов одним FrozenIndex без удалённых документов; сами сегменты не меняются
+    FrozenIndex BuildCompactIndex() const;
+
+    // Заменяет содержимое пустого индекса одним запечатанным сегментом с документами [0, end_ordinal)
+    void Load(FrozenIndex postings, int end_ordinal);
+
+private:
+    // изменяемый сегмент: постинги документов с ordinal не меньше mutable_first_ordinal_
+    std::vector<std::map<int, double>> mutable_postings_;
+    // верхняя граница tf каждого терма в изменяемом сегменте; при удалении не уменьшается
+    std::vector<double> mutable_max_term_freqs_;
+    int mutable_first_ordinal_ = 0;
+    int end_ordinal_ = 0;
+    // читается и фоновым потоком
+    std::atomic<size_t> segment_document_limit_{ DEFAULT_SEGMENT_DOCUMENT_LIMIT };
+
+    // удалённые документы; бит не сбрасывается и после вычистки постингов, так как ordinal не переиспользуются.
+    // Пишущий поток меняет карту под removed_documents_mutex_, фоновый поток под ним же снимает копию.
+    DynamicBitset removed_documents_;
+    mutable std::mutex removed_documents_mutex_;
+    // удаления из запечатанных сегментов с последней фоновой вычистки
+    size_t pending_removal_count_ = 0;
+
+    // опубликованный список запечатанных сегментов. Читатели берут его через std::atomic_load,
+    // новый список публикуется через std::atomic_store под segments_mutex_, так что публикации не теряются.
+    // Слияния и пересборки сегментов выполняются по одной под merge_mutex_, поэтому между ними
+    // позиции сегментов в списке не меняются.
+    std::shared_ptr<const SegmentList> sealed_segments_ = std::make_shared<const SegmentList>();
+    mutable std::mutex segments_mutex_;
+    std::mutex merge_mutex_;
+    std::condition_variable merge_condition_;
+    bool stop_merging_ = false;
+    bool purge_requested_ = false;
+    std::thread merge_thread_;
+
+    DynamicBitset CopyRemovedDocuments() const;
+
+    // Отмечает документ удалённым; true, если пора будить фоновую вычистку. Вызывается под removed_documents_mutex_
+    bool MarkRemoved(int ordinal);
+
+    void RequestPurge();
+
+    void Seal();
+
+    // Пересобирает сегменты, в которых удалено не меньше четверти диапазона; вызывается под merge_mutex_
+    void PurgeSegments();
+
+    // Полуинтервал позиций соседних сегментов, которые пора слить; пустой, если таких нет
+    std::pair<size_t, size_t> FindMergeRange(const SegmentList& segments) const;
+
+    // Публикует новый список запечатанных сегментов; вызывается под segments_mutex_
+    void PublishSegments(SegmentList segments);
+
+    // Сливает сегменты с позициями из [first, last); вызывается под merge_mutex_
+    void MergeSegments(size_t first, size_t last);
+
+    void StartMergeThread();
+
+    void RunMerges();
+};
+
+template <typename Callback>
+void SegmentedIndex::Snapshot::ForEachPosting(TermId term_id, Callback callback) const {
+    for (const auto& segment : *sealed_segments_) {
+        segment->postings.ForEachPosting(term_id, callback);
+    }
+    if (term_id < index_->mutable_postings_.size()) {
+        for (const auto [ordinal, term_freq] : index_->mutable_postings_[term_id]) {
+            callback(ordinal, term_freq);
+        }
+    }
+}
@@ -0,0 +1,281 @@
+﻿#include "shard_process.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "shard_protocol.h"
+#include "string_processing.h"
+
+using namespace std::literals::string_literals;
+
+static sockaddr_un MakeSocketAddress(const std::string& socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("socket path is too long"s);
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+// Все дескрипторы сокетов создаются с FD_CLOEXEC: иначе шард, запущенный после подключения агрегатора
+// к остальным шардам, унаследовал бы эти соединения, и после их закрытия агрегатором шарды не увидели бы EOF
+static int CreateUnixSocket() {
+#ifdef SOCK_CLOEXEC
+    return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+static int AcceptConnection(int listen_fd) {
+#ifdef __linux__
+    return accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+int ListenUnixSocket(const std::string& socket_path) {
+    const sockaddr_un address = MakeSocketAddress(socket_path);
+    const int fd = CreateUnixSocket();
+    if (fd < 0) {
+        throw std::runtime_error("cannot create socket"s);
+    }
+    unlink(socket_path.c_str());
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot listen on "s + socket_path);
+    }
+    return fd;
+}
+
+int ConnectUnixSocket(const std::string& socket_path) {
+    const sockaddr_un address = MakeSocketAddress(socket_path);
+    const int fd = CreateUnixSocket();
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Первый аргумент командной строки процесса шарда; за ним дескриптор сокета, путь сокета и стоп-слова
+static constexpr char SHARD_PROCESS_FLAG[] = "--search-server-shard";
+
+// Путь к исполняемому файлу для запуска шардов; вне Linux — argv[0], запомненный RunShardProcess
+static std::string executable_path;
+
+// Статус из запроса проверяется: недопустимое значение индексировало бы битовые карты статусов
+static DocumentStatus ReadDocumentStatus(MessageReader& request) {
+    const uint8_t status = request.ReadUint8();
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("invalid document status"s);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+// Выполняет запрос и пишет нагрузку ответа без статуса
+static void HandleShardRequest(SearchServer& server, ShardRequestType type, MessageReader& request, MessageWriter& response) {
+    switch (type) {
+    case ShardRequestType::ADD_DOCUMENT: {
+        const int document_id = request.ReadInt32();
+        const std::string_view text = request.ReadString();
+        const DocumentStatus status = ReadDocumentStatus(request);
+        std::vector<int> ratings(request.ReadCount(sizeof(int32_t)));
+        for (int& rating : ratings) {
+            rating = request.ReadInt32();
+        }
+        server.AddDocument(document_id, text, status, ratings);
+        break;
+    }
+    case ShardRequestType::REMOVE_DOCUMENT:
+        server.RemoveDocument(request.ReadInt32());
+        break;
+    case ShardRequestType::GET_WORD_DOCUMENT_COUNTS: {
+        // минус-слова в IDF не участвуют; некорректные слова отвергнет следующий запрос FIND_TOP_DOCUMENTS
+        std::vector<std::pair<std::string_view, int>> word_counts;
+        for (const std::string_view word : WordRange(request.ReadString())) {
+            if (word.empty() || word[0] == '-') {
+                continue;
+            }
+            if (const int document_count = server.GetWordDocumentCount(word); document_count > 0) {
+                word_counts.emplace_back(word, document_count);
+            }
+        }
+        response.WriteUint32(static_cast<uint32_t>(server.GetDocumentCount()));
+        response.WriteUint32(static_cast<uint32_t>(word_counts.size()));
+        for (const auto& [word, document_count] : word_counts) {
+            response.WriteString(word);
+            response.WriteInt32(document_count);
+        }
+        break;
+    }
+    case ShardRequestType::FIND_TOP_DOCUMENTS: {
+        const std::string_view raw_query = request.ReadString();
+        const DocumentStatus status = ReadDocumentStatus(request);
+        // больше документов, чем есть в шарде, не вернуть, а под top_k заранее резервируется память
+        const size_t top_k = std::min<size_t>(request.ReadUint32(), server.GetDocumentCount());
+        SearchServer::WordInverseDocumentFreqs inverse_document_freqs;
+        for (uint32_t i = request.ReadCount(sizeof(uint32_t) + sizeof(double)); i > 0; --i) {
+            const std::string_view word = request.ReadString();
+            inverse_document_freqs.emplace(word, request.ReadDouble());
+        }
+        const auto documents = server.FindTopDocuments(std::execution::seq, raw_query, StatusPredicate{ status }, top_k, inverse_document_freqs);
+        response.WriteUint32(static_cast<uint32_t>(documents.size()));
+        for (const Document& document : documents) {
+            response.WriteInt32(document.id);
+            response.WriteDouble(document.relevance);
+            response.WriteInt32(document.rating);
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("unknown request"s);
+    }
+}
+
+void ServeShard(int listen_fd, SearchServer& server) {
+    while (true) {
+        const int fd = AcceptConnection(listen_fd);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // ресурсы освободятся, когда закроются другие дескрипторы; без паузы цикл занял бы ядро целиком
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            throw std::runtime_error("cannot accept connection: "s + std::strerror(errno));
+        }
+        uint8_t type = 0;
+        std::string payload;
+        while (ReceiveMessage(fd, type, payload, Deadline::max())) {
+            MessageWriter response;
+            if (static_cast<ShardRequestType>(type) == ShardRequestType::SHUTDOWN) {
+                response.WriteUint8(static_cast<uint8_t>(ShardResponseStatus::OK));
+                response.WriteString({});
+                SendMessage(fd, type, response.GetData(), Deadline::max());
+                close(fd);
+                return;
+            }
+            MessageReader request(payload);
+            MessageWriter result;
+            try {
+                HandleShardRequest(server, static_cast<ShardRequestType>(type), request, result);
+                response.WriteUint8(static_cast<uint8_t>(ShardResponseStatus::OK));
+                response.WriteString(result.GetData());
+            }
+            catch (const std::invalid_argument& error) {
+                response.WriteUint8(static_cast<uint8_t>(ShardResponseStatus::INVALID_ARGUMENT));
+                response.WriteString(error.what());
+            }
+            catch (const std::runtime_error&) {
+                break;
+            }
+            if (!SendMessage(fd, type, response.GetData(), Deadline::max())) {
+                break;
+            }
+        }
+        close(fd);
+    }
+}
+
+// Между fork и exec дочерний процесс только делает системные вызовы: всё, что выделяет память,
+// готовится заранее, пока процесс ещё целый
+pid_t StartShardProcess(const std::string& socket_path, const std::string& stop_words, int cpu) {
+#ifdef __linux__
+    const std::string executable = "/proc/self/exe"s;
+#else
+    const std::string executable = executable_path;
+#endif
+    if (executable.empty()) {
+        throw std::runtime_error("shard executable is unknown: main must call RunShardProcess"s);
+    }
+    const int listen_fd = ListenUnixSocket(socket_path);
+    std::vector<std::string> arguments = { executable, SHARD_PROCESS_FLAG, std::to_string(listen_fd), socket_path, stop_words };
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+#ifdef __linux__
+    // ядро вне cpu_set_t задать нельзя: такой шард работает без привязки
+    const bool pin_to_cpu = cpu >= 0 && cpu < CPU_SETSIZE;
+#endif
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(listen_fd);
+        throw std::runtime_error("cannot start shard process"s);
+    }
+    if (pid > 0) {
+        close(listen_fd);
+        return pid;
+    }
+    // из всех сокетов через exec проходит только слушающий сокет этого шарда
+    fcntl(listen_fd, F_SETFD, 0);
+#ifdef __linux__
+    if (pin_to_cpu) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        // привязка только ускоряет шард, поэтому при отказе (ядро недоступно процессу) он запускается без неё
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            const char message[] = "shard process is not pinned: sched_setaffinity failed\n";
+            [[maybe_unused]] const ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+        }
+    }
+#endif
+    execv(argv[0], argv.data());
+    _exit(127);
+}
+
+int RunShardProcess(int argc, char* argv[]) {
+    if (argc > 0 && executable_path.empty()) {
+        executable_path = argv[0];
+    }
+    if (argc != 5 || std::strcmp(argv[1], SHARD_PROCESS_FLAG) != 0) {
+        return -1;
+    }
+    const int listen_fd = std::atoi(argv[2]);
+    int exit_code = 0;
+    try {
+        SearchServer server{ std::string(argv[4]) };
+        ServeShard(listen_fd, server);
+    }
+    catch (...) {
+        exit_code = 1;
+    }
+    close(listen_fd);
+    unlink(argv[3]);
+    return exit_code;
+}
+
+#endif
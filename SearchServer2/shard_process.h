@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#ifndef _WIN32
+
+#include <string>
+
+#include <sys/types.h>
+
+#include "search_server.h"
+
+// Создаёт слушающий Unix-сокет по пути socket_path, заменяя оставшийся от прежнего запуска файл
+int ListenUnixSocket(const std::string& socket_path);
+
+// Подключается к Unix-сокету; возвращает -1, если шард недоступен
+int ConnectUnixSocket(const std::string& socket_path);
+
+// Обслуживает запросы агрегатора по протоколу shard_protocol.h, пока не придёт SHUTDOWN.
+// Соединения обслуживаются по одному; разорванное или некорректное соединение закрывается.
+// Если новые соединения нельзя принять из-за нехватки дескрипторов, повторяет попытку с паузой;
+// при другой ошибке accept бросает std::runtime_error.
+void ServeShard(int listen_fd, SearchServer& server);
+
+// Запускает шард отдельным процессом с пустым сервером и возвращает его pid. Сокет начинает
+// слушать ещё до возврата, поэтому к шарду можно подключаться сразу. При cpu >= 0 процесс
+// привязывается к этому ядру (только в Linux); ядро не меньше CPU_SETSIZE или недоступное процессу
+// пропускается, и шард работает без привязки.
+// Дочерний процесс сразу заменяется (exec) новым экземпляром текущей программы: после fork
+// в многопоточном процессе блокировки других потоков (пул TBB, слияние сегментов) остались бы
+// захваченными навсегда. Поэтому main программы должна начинаться с вызова RunShardProcess.
+pid_t StartShardProcess(const std::string& socket_path, const std::string& stop_words, int cpu = -1);
+
+// Точка входа процесса шарда. Если командная строка — та, с которой StartShardProcess запускает шард,
+// обслуживает шард до SHUTDOWN и возвращает код завершения процесса; иначе возвращает -1.
+// Вызывается первым в main, до создания потоков.
+int RunShardProcess(int argc, char* argv[]);
+
+#endif
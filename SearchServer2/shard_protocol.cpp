@@ -0,0 +1,176 @@
+﻿#include "shard_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+using namespace std::literals::string_literals;
+
+void MessageWriter::WriteUint8(uint8_t value) {
+    WriteBytes(&value, sizeof(value));
+}
+
+void MessageWriter::WriteInt32(int32_t value) {
+    WriteBytes(&value, sizeof(value));
+}
+
+void MessageWriter::WriteUint32(uint32_t value) {
+    WriteBytes(&value, sizeof(value));
+}
+
+void MessageWriter::WriteDouble(double value) {
+    WriteBytes(&value, sizeof(value));
+}
+
+void MessageWriter::WriteString(std::string_view value) {
+    WriteUint32(static_cast<uint32_t>(value.size()));
+    data_.append(value);
+}
+
+void MessageWriter::WriteBytes(const void* bytes, size_t size) {
+    data_.append(static_cast<const char*>(bytes), size);
+}
+
+uint8_t MessageReader::ReadUint8() {
+    uint8_t value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+}
+
+int32_t MessageReader::ReadInt32() {
+    int32_t value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+}
+
+uint32_t MessageReader::ReadUint32() {
+    uint32_t value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+}
+
+double MessageReader::ReadDouble() {
+    double value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+}
+
+uint32_t MessageReader::ReadCount(size_t element_size) {
+    const uint32_t count = ReadUint32();
+    if (element_size > 0 && count > data_.size() / element_size) {
+        throw std::runtime_error("truncated message"s);
+    }
+    return count;
+}
+
+std::string_view MessageReader::ReadString() {
+    const uint32_t size = ReadUint32();
+    if (size > data_.size()) {
+        throw std::runtime_error("truncated message"s);
+    }
+    const std::string_view value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return value;
+}
+
+void MessageReader::ReadBytes(void* bytes, size_t size) {
+    if (size > data_.size()) {
+        throw std::runtime_error("truncated message"s);
+    }
+    std::memcpy(bytes, data_.data(), size);
+    data_.remove_prefix(size);
+}
+
+#ifndef _WIN32
+
+// Ждёт готовности сокета не дольше, чем до deadline
+static bool WaitForSocket(int fd, short events, Deadline deadline) {
+    while (true) {
+        int timeout = -1;
+        if (deadline != Deadline::max()) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() < 0) {
+                return false;
+            }
+            timeout = static_cast<int>(remaining.count());
+        }
+        pollfd descriptor{ fd, events, 0 };
+        const int result = poll(&descriptor, 1, timeout);
+        if (result > 0) {
+            return true;
+        }
+        if (result == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+static bool SendBytes(int fd, const char* bytes, size_t size, Deadline deadline) {
+    while (size > 0) {
+        if (!WaitForSocket(fd, POLLOUT, deadline)) {
+            return false;
+        }
+        const ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool ReceiveBytes(int fd, char* bytes, size_t size, Deadline deadline) {
+    while (size > 0) {
+        if (!WaitForSocket(fd, POLLIN, deadline)) {
+            return false;
+        }
+        const ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool SendMessage(int fd, uint8_t type, std::string_view payload, Deadline deadline) {
+    if (payload.size() > MAX_MESSAGE_SIZE) {
+        return false;
+    }
+    MessageWriter header;
+    header.WriteUint32(static_cast<uint32_t>(payload.size()));
+    header.WriteUint8(type);
+    return SendBytes(fd, header.GetData().data(), header.GetData().size(), deadline)
+        && SendBytes(fd, payload.data(), payload.size(), deadline);
+}
+
+bool ReceiveMessage(int fd, uint8_t& type, std::string& payload, Deadline deadline) {
+    char header[sizeof(uint32_t) + sizeof(uint8_t)];
+    if (!ReceiveBytes(fd, header, sizeof(header), deadline)) {
+        return false;
+    }
+    MessageReader reader(std::string_view(header, sizeof(header)));
+    const uint32_t size = reader.ReadUint32();
+    type = reader.ReadUint8();
+    if (size > MAX_MESSAGE_SIZE) {
+        return false;
+    }
+    payload.resize(size);
+    return ReceiveBytes(fd, payload.data(), size, deadline);
+}
+
+#endif
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Двоичный протокол между агрегатором и процессами шардов (см. remote_sharded_search_server.h).
+// Сообщение — длина нагрузки (uint32), тип (uint8) и нагрузка из полей фиксированной ширины
+// и строк с длиной впереди. Процессы работают на одной машине, поэтому числа передаются в её порядке байт.
+//
+// Запросы и нагрузки ответов:
+//   ADD_DOCUMENT             id, текст, статус, рейтинги                       -> —
+//   REMOVE_DOCUMENT          id                                                -> —
+//   GET_WORD_DOCUMENT_COUNTS запрос                                            -> число документов, пары (слово, число документов)
+//   FIND_TOP_DOCUMENTS       запрос, статус, top_k, пары (слово, IDF)          -> тройки (id, релевантность, рейтинг)
+//   SHUTDOWN                 —                                                 -> —
+// Ответ начинается с ShardResponseStatus; при INVALID_ARGUMENT дальше идёт текст исключения.
+enum class ShardRequestType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT,
+    GET_WORD_DOCUMENT_COUNTS,
+    FIND_TOP_DOCUMENTS,
+    SHUTDOWN,
+};
+
+enum class ShardResponseStatus : uint8_t {
+    OK,
+    INVALID_ARGUMENT,
+};
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+class MessageWriter {
+public:
+    void WriteUint8(uint8_t value);
+    void WriteInt32(int32_t value);
+    void WriteUint32(uint32_t value);
+    void WriteDouble(double value);
+    void WriteString(std::string_view value);
+
+    const std::string& GetData() const {
+        return data_;
+    }
+
+private:
+    std::string data_;
+
+    void WriteBytes(const void* bytes, size_t size);
+};
+
+// Читает поля нагрузки; на обрезанном сообщении бросает std::runtime_error
+class MessageReader {
+public:
+    explicit MessageReader(std::string_view data)
+        : data_(data) {
+    }
+
+    uint8_t ReadUint8();
+    int32_t ReadInt32();
+    uint32_t ReadUint32();
+    double ReadDouble();
+    // Читает число элементов, за которым идут сами элементы. Счётчик приходит извне, поэтому проверяется
+    // до выделения памяти: бросает std::runtime_error, если count * element_size больше остатка нагрузки.
+    // Для элементов переменной длины element_size — их наименьший размер.
+    uint32_t ReadCount(size_t element_size);
+    std::string_view ReadString();
+
+private:
+    std::string_view data_;
+
+    void ReadBytes(void* bytes, size_t size);
+};
+
+// Кодирование нагрузок переносимо: им пользуется и журнал упреждающей записи (write_ahead_log.h).
+// Обмен сообщениями через сокеты — только POSIX.
+#ifndef _WIN32
+
+// Наибольший размер нагрузки сообщения. Длина приходит от другого процесса, и без предела
+// одно испорченное сообщение заставило бы выделить до 4 ГиБ.
+constexpr uint32_t MAX_MESSAGE_SIZE = 64u << 20;
+
+// Отправляет сообщение целиком; false при ошибке сокета, по истечении deadline
+// или если нагрузка больше MAX_MESSAGE_SIZE
+bool SendMessage(int fd, uint8_t type, std::string_view payload, Deadline deadline);
+
+// Принимает сообщение целиком; false при ошибке сокета, закрытом соединении, по истечении deadline
+// или если заявленная длина нагрузки больше MAX_MESSAGE_SIZE (память под неё тогда не выделяется)
+bool ReceiveMessage(int fd, uint8_t& type, std::string& payload, Deadline deadline);
+
+#endif
@@ -0,0 +1,135 @@
+﻿#include "sharded_search_server.h"
+#include "string_processing.h"
+
+#include <cmath>
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    std::vector<std::vector<NewDocument>> shard_documents(shards_.size());
+    // номера документов шарда в пакете
+    std::vector<std::vector<size_t>> shard_indexes(shards_.size());
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const size_t shard = GetShardIndex(documents[index].id, shards_.size());
+        shard_documents[shard].push_back(documents[index]);
+        shard_indexes[shard].push_back(index);
+    }
+
+    // шард останавливается на первом ошибочном документе своей части
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::vector<size_t> accepted_counts(shards_.size());
+    ForEachShard([&](size_t shard) {
+        SearchServer& server = *shards_[shard];
+        const size_t document_count = server.GetDocumentCount();
+        try {
+            server.AddDocuments(std::execution::seq, shard_documents[shard]);
+        }
+        catch (const std::invalid_argument&) {
+            errors[shard] = std::current_exception();
+        }
+        accepted_counts[shard] = server.GetDocumentCount() - document_count;
+        });
+
+    size_t first_error_index = documents.size();
+    std::exception_ptr first_error;
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        if (errors[shard] && shard_indexes[shard][accepted_counts[shard]] < first_error_index) {
+            first_error_index = shard_indexes[shard][accepted_counts[shard]];
+            first_error = errors[shard];
+        }
+    }
+    if (!first_error) {
+        return;
+    }
+    // при поочерёдном добавлении документы после ошибочного не попали бы в индекс
+    ForEachShard([&](size_t shard) {
+        std::vector<int> rejected_ids;
+        for (size_t i = 0; i < accepted_counts[shard]; ++i) {
+            if (shard_indexes[shard][i] > first_error_index) {
+                rejected_ids.push_back(shard_documents[shard][i].id);
+            }
+        }
+        shards_[shard]->RemoveDocuments(rejected_ids);
+        });
+    std::rethrow_exception(first_error);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    GetShard(document_id).RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::vector<std::vector<int>> shard_document_ids(shards_.size());
+    for (const int document_id : document_ids) {
+        shard_document_ids[GetShardIndex(document_id, shards_.size())].push_back(document_id);
+    }
+    ForEachShard([&](size_t shard) {
+        shards_[shard]->RemoveDocuments(shard_document_ids[shard]);
+        });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(raw_query, StatusPredicate{ status }, top_k);
+}
+
+SearchServer::MatchDocumentResult ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+size_t ShardedSearchServer::GetDocumentCount() const {
+    size_t document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+void ShardedSearchServer::Freeze() {
+    ForEachShard([this](size_t shard) {
+        shards_[shard]->Freeze();
+        });
+}
+
+void ShardedSearchServer::SetRetrievalAlgorithm(RetrievalAlgorithm algorithm) {
+    for (const auto& shard : shards_) {
+        shard->SetRetrievalAlgorithm(algorithm);
+    }
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id, size_t shard_count) {
+    const uint64_t hash = static_cast<uint64_t>(static_cast<uint32_t>(document_id)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>((hash >> 32) % shard_count);
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+    return *shards_[GetShardIndex(document_id, shards_.size())];
+}
+
+const SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+    return *shards_[GetShardIndex(document_id, shards_.size())];
+}
+
+// Некорректные слова здесь не проверяются: запрос с ними отвергнут шарды на втором шаге
+SearchServer::WordInverseDocumentFreqs ShardedSearchServer::ComputeInverseDocumentFreqs(std::string_view raw_query) const {
+    const double document_count = GetDocumentCount() * 1.0;
+    SearchServer::WordInverseDocumentFreqs inverse_document_freqs;
+    for (std::string_view word : WordRange(raw_query)) {
+        if (!word.empty() && word[0] == '-') {
+            continue;
+        }
+        int word_document_count = 0;
+        for (const auto& shard : shards_) {
+            word_document_count += shard->GetWordDocumentCount(word);
+        }
+        if (word_document_count > 0) {
+            inverse_document_freqs.emplace(word, std::log(document_count / word_document_count));
+        }
+    }
+    return inverse_document_freqs;
+}
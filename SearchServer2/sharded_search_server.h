@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+#include "top_k.h"
+
+// Поисковый сервер из нескольких шардов — независимых SearchServer. Документ попадает в шард
+// по хешу своего id; шарды индексируют документы и отвечают на запросы параллельно.
+// Запрос выполняется в два шага: сначала по всем шардам собирается число документов со словами
+// запроса и считается IDF по всей коллекции, затем каждый шард ищет лучшие документы с этими IDF,
+// и выдачи шардов сливаются. Поэтому релевантности совпадают с релевантностями одного сервера.
+class ShardedSearchServer {
+public:
+    template <typename StopWords>
+    ShardedSearchServer(const StopWords& stop_words, size_t shard_count);
+
+    size_t GetShardCount() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Шарды добавляют свои части пакета параллельно. При ошибке результат тот же, что у поочерёдных
+    // вызовов AddDocument: документы после ошибочного, успевшие попасть в другие шарды, удаляются.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    SearchServer::MatchDocumentResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    size_t GetDocumentCount() const;
+
+    void Freeze();
+
+    void SetRetrievalAlgorithm(RetrievalAlgorithm algorithm);
+
+    // Номер шарда документа; последовательные id перемешиваются, чтобы шарды заполнялись равномерно
+    static size_t GetShardIndex(int document_id, size_t shard_count);
+
+private:
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+
+    SearchServer& GetShard(int document_id);
+    const SearchServer& GetShard(int document_id) const;
+
+    // IDF слов запроса по всем шардам
+    SearchServer::WordInverseDocumentFreqs ComputeInverseDocumentFreqs(std::string_view raw_query) const;
+
+    // Выполняет action(shard) для всех шардов параллельно; первое исключение пробрасывается после завершения всех
+    template <typename Action>
+    void ForEachShard(Action action) const;
+};
+
+template <typename StopWords>
+ShardedSearchServer::ShardedSearchServer(const StopWords& stop_words, size_t shard_count) {
+    using namespace std::literals::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("shard count must be positive"s);
+    }
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        shards_.push_back(std::make_unique<SearchServer>(stop_words));
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+    const SearchServer::WordInverseDocumentFreqs inverse_document_freqs = ComputeInverseDocumentFreqs(raw_query);
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    ForEachShard([&](size_t shard) {
+        shard_documents[shard] = shards_[shard]->FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k, inverse_document_freqs);
+        });
+    return MergeTopK(std::move(shard_documents), top_k, SearchServer::IsMoreRelevant);
+}
+
+template <typename Action>
+void ShardedSearchServer::ForEachShard(Action action) const {
+    std::vector<size_t> shards(shards_.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    // исключение, покинувшее параллельный алгоритм, завершило бы программу
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::for_each(std::execution::par, shards.begin(), shards.end(), [&](size_t shard) {
+        try {
+            action(shard);
+        }
+        catch (...) {
+            errors[shard] = std::current_exception();
+        }
+        });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+﻿#include "stop_word_set.h"
+
+#include <stdexcept>
+
+using namespace std::literals::string_literals;
+
+// Слоты таблицы заполняются не больше чем наполовину
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words) {
+    size_t slot_count = 1;
+    while (slot_count < words.size() * 2) {
+        slot_count *= 2;
+    }
+    slots_.resize(slot_count);
+    offsets_.reserve(words.size() + 1);
+    for (const std::string& word : words) {
+        if (chars_.size() + word.size() >= EMPTY_SLOT) {
+            throw std::invalid_argument("Stop words are too long"s);
+        }
+        const uint32_t offset = static_cast<uint32_t>(chars_.size());
+        chars_ += word;
+        offsets_.push_back(static_cast<uint32_t>(chars_.size()));
+        length_mask_ |= uint64_t(1) << GetLengthBit(word.size());
+
+        const uint32_t prefix = LoadPrefix(word);
+        size_t slot = Hash(word, prefix) & (slot_count - 1);
+        while (slots_[slot].offset != EMPTY_SLOT) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots_[slot] = { offset, static_cast<uint32_t>(word.size()), prefix };
+    }
+}
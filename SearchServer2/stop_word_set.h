@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемое множество стоп-слов, построенное один раз при создании сервера.
+// Слова лежат подряд в одном буфере, поиск — хеш-таблица с открытой адресацией. В слоте хранятся
+// длина слова и его первые четыре байта, поэтому несовпадения почти всегда отсекаются по слоту,
+// а слово до четырёх байт сравнивается целиком, не обращаясь к буферу. Перед таблицей проверяется
+// маска длин стоп-слов: слово длины, которой среди стоп-слов нет, отвергается без обращения к таблице.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const {
+        if (((length_mask_ >> GetLengthBit(word.size())) & 1) == 0) {
+            return false;
+        }
+        const uint32_t prefix = LoadPrefix(word);
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = Hash(word, prefix) & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots_[i];
+            if (slot.offset == EMPTY_SLOT) {
+                return false;
+            }
+            if (slot.length == word.size() && slot.prefix == prefix
+                && (word.size() <= PREFIX_SIZE
+                    || std::memcmp(chars_.data() + slot.offset + PREFIX_SIZE, word.data() + PREFIX_SIZE, word.size() - PREFIX_SIZE) == 0)) {
+                return true;
+            }
+        }
+    }
+
+    size_t Size() const {
+        return offsets_.size() - 1;
+    }
+
+    // Слова по возрастанию
+    std::string_view GetWord(size_t index) const {
+        return std::string_view(chars_).substr(offsets_[index], offsets_[index + 1] - offsets_[index]);
+    }
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+    static constexpr size_t PREFIX_SIZE = 4;
+
+    struct Slot {
+        uint32_t offset = EMPTY_SLOT;
+        uint32_t length = 0;
+        // первые байты слова, недостающие — нули
+        uint32_t prefix = 0;
+    };
+
+    std::string chars_;
+    std::vector<uint32_t> offsets_ = { 0 };
+    std::vector<Slot> slots_;
+    // бит i — есть стоп-слово длины i; длины от 63 делят последний бит
+    uint64_t length_mask_ = 0;
+
+    static size_t GetLengthBit(size_t length) {
+        return length < 63 ? length : 63;
+    }
+
+    static uint32_t LoadPrefix(std::string_view word) {
+        uint32_t prefix = 0;
+        std::memcpy(&prefix, word.data(), word.size() < PREFIX_SIZE ? word.size() : PREFIX_SIZE);
+        return prefix;
+    }
+
+    // Смешиваются длина, первые и последние четыре байта, так что хеш считается за постоянное время
+    static size_t Hash(std::string_view word, uint32_t prefix) {
+        uint32_t suffix = 0;
+        if (word.size() > PREFIX_SIZE) {
+            std::memcpy(&suffix, word.data() + word.size() - PREFIX_SIZE, PREFIX_SIZE);
+        }
+        const uint64_t key = (uint64_t(prefix) << 32 | suffix) ^ (uint64_t(word.size()) * 0xC2B2AE3D27D4EB4Full);
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+};
@@ -1,4 +1,17 @@
-#include "string_processing.h"
+﻿#include "string_processing.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.h"
+
+#if SEARCH_SERVER_X86
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 //std::vector<std::string> SplitIntoWords(const std::string& text) {
 //    std::vector<std::string> words;
@@ -38,22 +51,176 @@
 //}
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
-    std::vector<std::string_view> result;
-    const int64_t pos_end = text.npos;
+    size_t first_invalid_word = 0;
+    return SplitIntoWords(text, first_invalid_word);
+}
+
+static size_t CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+}
+
+static bool IsControl(char c) {
+    return static_cast<unsigned char>(c) < 0x20;
+}
+
+static void ClassifyScalar(const char* data, size_t size, uint32_t& spaces, uint32_t& controls) {
+    spaces = 0;
+    controls = 0;
+    for (size_t i = 0; i < size; ++i) {
+        spaces |= uint32_t(data[i] == ' ') << i;
+        controls |= uint32_t(IsControl(data[i])) << i;
+    }
+}
+
+#if SEARCH_SERVER_X86
+
+// Блок короче 32 байт копируется в буфер, дополненный пробелами: они не меняют ни слов, ни масок
+static const char* PadBlock(const char* data, size_t size, char* buffer) {
+    std::memset(buffer, ' ', 32);
+    std::memcpy(buffer, data, size);
+    return buffer;
+}
+
+// Управляющий символ — байт не больше 0x1F без знака, то есть байт, который min с 0x1F не меняет
+SEARCH_SERVER_TARGET("sse2")
+static void ClassifySse2(const char* data, size_t size, uint32_t& spaces, uint32_t& controls) {
+    alignas(16) char buffer[32];
+    if (size < 32) {
+        data = PadBlock(data, size, buffer);
+    }
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i max_control = _mm_set1_epi8(0x1F);
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+    spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, space)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, space))) << 16;
+    controls = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(low, max_control), low)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(high, max_control), high))) << 16;
+}
+
+SEARCH_SERVER_TARGET("avx2")
+static void ClassifyAvx2(const char* data, size_t size, uint32_t& spaces, uint32_t& controls) {
+    alignas(32) char buffer[32];
+    if (size < 32) {
+        data = PadBlock(data, size, buffer);
+    }
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' '))));
+    controls = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(block, _mm256_set1_epi8(0x1F)), block)));
+}
+
+#endif
+
+static Tokenizer ResolveTokenizer(Tokenizer tokenizer) {
+    if (tokenizer == Tokenizer::AUTO) {
+        tokenizer = Tokenizer::AVX2;
+    }
+    if (tokenizer == Tokenizer::AVX2 && !CpuSupportsAvx2()) {
+        tokenizer = Tokenizer::SSE2;
+    }
+    if (tokenizer == Tokenizer::SSE2 && !CpuSupportsSse2()) {
+        tokenizer = Tokenizer::SCALAR;
+    }
+    return tokenizer;
+}
+
+static WordRange::ClassifyBlock GetClassifier(Tokenizer tokenizer) {
+    switch (ResolveTokenizer(tokenizer)) {
+#if SEARCH_SERVER_X86
+    case Tokenizer::AVX2:
+        return ClassifyAvx2;
+    case Tokenizer::SSE2:
+        return ClassifySse2;
+#endif
+    default:
+        return ClassifyScalar;
+    }
+}
+
+WordRange::WordRange(std::string_view text, Tokenizer tokenizer)
+    : text_(text)
+    , classify_(GetClassifier(tokenizer)) {
+}
+
+WordRange::Iterator::Iterator(std::string_view text, ClassifyBlock classify, size_t position)
+    : text_(text)
+    , classify_(classify) {
+    FindWord(position);
+}
+
+void WordRange::Iterator::LoadBlock(size_t position) {
+    block_offset_ = position - position % BLOCK_SIZE;
+    const size_t size = std::min(BLOCK_SIZE, text_.size() - block_offset_);
+    classify_(text_.data() + block_offset_, size, spaces_, controls_);
+    if (size < BLOCK_SIZE) {
+        spaces_ |= ~uint32_t(0) << size;
+    }
+    is_block_loaded_ = true;
+}
+
+void WordRange::Iterator::FindWord(size_t position) {
+    // пропуск пробелов
+    while (position < text_.size()) {
+        if (!is_block_loaded_ || position < block_offset_ || position >= block_offset_ + BLOCK_SIZE) {
+            LoadBlock(position);
+        }
+        const uint32_t letters = ~spaces_ >> (position - block_offset_);
+        if (letters != 0) {
+            position += CountTrailingZeros(letters);
+            break;
+        }
+        position = block_offset_ + BLOCK_SIZE;
+    }
+    if (position >= text_.size()) {
+        word_start_ = text_.size();
+        word_ = {};
+        is_valid_ = true;
+        return;
+    }
+
+    // слово до следующего пробела; биты за концом текста — пробелы, так что конец всегда найдётся
+    word_start_ = position;
+    is_valid_ = true;
     while (true) {
-        int64_t space = text.find(' ');
-        auto word = (space == pos_end ? text.substr(0) : text.substr(0, space));
-        if (!word.empty()) {
-            result.push_back(word);
+        if (position >= block_offset_ + BLOCK_SIZE) {
+            LoadBlock(position);
+        }
+        const size_t shift = position - block_offset_;
+        const uint32_t spaces = spaces_ >> shift;
+        const size_t length = spaces != 0 ? CountTrailingZeros(spaces) : BLOCK_SIZE - shift;
+        const uint32_t word_bits = length < 32 ? (uint32_t(1) << length) - 1 : ~uint32_t(0);
+        if ((controls_ >> shift) & word_bits) {
+            is_valid_ = false;
         }
-        if (space == pos_end) {
+        position += length;
+        if (spaces != 0) {
             break;
         }
-        else {
-            text.remove_prefix(space + 1);
+    }
+    word_ = text_.substr(word_start_, position - word_start_);
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text, size_t& first_invalid_word, Tokenizer tokenizer) {
+    std::vector<std::string_view> words;
+    first_invalid_word = std::string_view::npos;
+    const WordRange range(text, tokenizer);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        if (!it.IsValid() && first_invalid_word == std::string_view::npos) {
+            first_invalid_word = words.size();
         }
+        words.push_back(*it);
+    }
+    if (first_invalid_word == std::string_view::npos) {
+        first_invalid_word = words.size();
     }
-    return result;
+    return words;
 }
 
 //std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
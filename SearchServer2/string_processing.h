@@ -1,12 +1,128 @@
-#pragma once
+﻿#pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Реализация разбиения на слова. AUTO выбирает самую быструю из поддерживаемых процессором;
+// неподдерживаемая процессором реализация заменяется скалярной.
+enum class Tokenizer {
+    AUTO,
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Слова текста, разделённые пробелами, без выделения памяти: итератор находит следующее слово
+// по требованию. Текст просматривается блоками по 32 байта; для блока сразу строятся маски пробелов
+// и управляющих символов (коды 0-31), с которыми слово недопустимо, поэтому проверка слова
+// не требует второго прохода. Текст должен жить дольше диапазона и его итераторов.
+class WordRange {
+public:
+    // Классифицирует size <= 32 байт с data: бит i масок относится к байту i
+    using ClassifyBlock = void (*)(const char* data, size_t size, uint32_t& spaces, uint32_t& controls);
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = const std::string_view&;
+
+        Iterator() = default;
+
+        reference operator*() const {
+            return word_;
+        }
+
+        pointer operator->() const {
+            return &word_;
+        }
+
+        // Нет ли в слове управляющих символов
+        bool IsValid() const {
+            return is_valid_;
+        }
+
+        Iterator& operator++() {
+            FindWord(word_start_ + word_.size());
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        // Сравниваются только итераторы одного диапазона
+        bool operator==(const Iterator& other) const {
+            return word_start_ == other.word_start_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class WordRange;
+
+        static constexpr size_t BLOCK_SIZE = 32;
+
+        std::string_view text_;
+        ClassifyBlock classify_ = nullptr;
+        // маски загруженного блока; биты за концом текста считаются пробелами
+        size_t block_offset_ = 0;
+        uint32_t spaces_ = 0;
+        uint32_t controls_ = 0;
+        bool is_block_loaded_ = false;
+
+        // у итератора конца word_start_ равен размеру текста
+        size_t word_start_ = 0;
+        std::string_view word_;
+        bool is_valid_ = true;
+
+        Iterator(std::string_view text, ClassifyBlock classify, size_t position);
+
+        void LoadBlock(size_t position);
+
+        // Находит первое слово, начинающееся не раньше position
+        void FindWord(size_t position);
+    };
+
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    // Реализация выбирается так же, как для SplitIntoWords
+    explicit WordRange(std::string_view text, Tokenizer tokenizer = Tokenizer::AUTO);
+
+    Iterator begin() const {
+        return Iterator(text_, classify_, 0);
+    }
+
+    Iterator end() const {
+        return Iterator(text_, classify_, text_.size());
+    }
+
+private:
+    std::string_view text_;
+    ClassifyBlock classify_;
+};
+
+// Разбивает текст по пробелам и в том же проходе ищет управляющие символы (коды 0-31), с которыми слово
+// недопустимо. first_invalid_word — номер первого такого слова или words.size(), если таких нет.
+// Векторные реализации просматривают текст блоками по 16 и 32 байта.
+// Когда вектор не нужен, слова лучше перебирать через WordRange.
+std::vector<std::string_view> SplitIntoWords(std::string_view text, size_t& first_invalid_word, Tokenizer tokenizer = Tokenizer::AUTO);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
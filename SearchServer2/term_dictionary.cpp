@@ -0,0 +1,113 @@
+﻿#include "term_dictionary.h"
+
+#include <algorithm>
+
+#include "index_file.h"
+
+using namespace std::literals::string_literals;
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    *this = other;
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this == &other) {
+        return *this;
+    }
+    // термы из файла общие, а string_view остальных должны указывать на собственное хранилище,
+    // поэтому они добавляются заново
+    base_word_offsets_ = other.base_word_offsets_;
+    base_word_chars_ = other.base_word_chars_;
+    base_slots_ = other.base_slots_;
+    base_term_count_ = other.base_term_count_;
+    storage_.clear();
+    words_.clear();
+    term_ids_.clear();
+    words_.reserve(other.words_.size());
+    term_ids_.reserve(other.words_.size());
+    for (const auto word : other.words_) {
+        Intern(word);
+    }
+    return *this;
+}
+
+TermDictionary TermDictionary::Open(const IndexFile& file) {
+    TermDictionary dictionary;
+    dictionary.base_word_offsets_ = file.GetColumn<uint64_t>(IndexSection::TERM_WORD_OFFSETS);
+    dictionary.base_word_chars_ = file.GetColumn<char>(IndexSection::TERM_WORD_CHARS);
+    dictionary.base_slots_ = file.GetColumn<TermId>(IndexSection::TERM_HASH_SLOTS);
+    const size_t term_count = dictionary.base_word_offsets_.Empty() ? 0 : dictionary.base_word_offsets_.Size() - 1;
+    if (term_count >= NO_TERM || !AreValidOffsets(dictionary.base_word_offsets_, dictionary.base_word_chars_.Size())) {
+        ThrowDamagedIndexFile("term words"s);
+    }
+    // FindBase обходит слоты по маске и останавливается только на пустом слоте
+    const Column<TermId>& slots = dictionary.base_slots_;
+    const size_t slot_count = slots.Size();
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0
+        || std::find(slots.begin(), slots.end(), NO_TERM) == slots.end()
+        || std::any_of(slots.begin(), slots.end(), [term_count](TermId term_id) { return term_id != NO_TERM && term_id >= term_count; })) {
+        ThrowDamagedIndexFile("term hash slots"s);
+    }
+    dictionary.base_term_count_ = static_cast<TermId>(term_count);
+    return dictionary;
+}
+
+// Слоты хеш-таблицы заполняются не больше чем наполовину
+void TermDictionary::Save(IndexFileWriter& writer) const {
+    const size_t term_count = Size();
+    std::vector<uint64_t> offsets = { 0 };
+    std::string chars;
+    size_t slot_count = 1;
+    while (slot_count < term_count * 2) {
+        slot_count *= 2;
+    }
+    std::vector<TermId> slots(slot_count, NO_TERM);
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const std::string_view word = GetWord(term_id);
+        chars.append(word);
+        offsets.push_back(chars.size());
+        size_t slot = ComputeChecksum(word.data(), word.size()) & (slot_count - 1);
+        while (slots[slot] != NO_TERM) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = term_id;
+    }
+    writer.WriteColumn(IndexSection::TERM_WORD_OFFSETS, offsets.data(), offsets.size());
+    writer.WriteColumn(IndexSection::TERM_WORD_CHARS, chars.data(), chars.size());
+    writer.WriteColumn(IndexSection::TERM_HASH_SLOTS, slots.data(), slots.size());
+}
+
+TermId TermDictionary::Intern(std::string_view word) {
+    if (const TermId term_id = FindBase(word); term_id != NO_TERM) {
+        return term_id;
+    }
+    if (const auto it = term_ids_.find(word); it != term_ids_.end()) {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(Size());
+    const std::string_view stored = storage_.emplace_back(word);
+    words_.push_back(stored);
+    term_ids_.emplace(stored, term_id);
+    return term_id;
+}
+
+TermId TermDictionary::Find(std::string_view word) const {
+    if (const TermId term_id = FindBase(word); term_id != NO_TERM) {
+        return term_id;
+    }
+    const auto it = term_ids_.find(word);
+    return it == term_ids_.end() ? NO_TERM : it->second;
+}
+
+TermId TermDictionary::FindBase(std::string_view word) const {
+    if (base_slots_.Empty()) {
+        return NO_TERM;
+    }
+    const size_t mask = base_slots_.Size() - 1;
+    for (size_t slot = ComputeChecksum(word.data(), word.size()) & mask; base_slots_[slot] != NO_TERM; slot = (slot + 1) & mask) {
+        if (GetWord(base_slots_[slot]) == word) {
+            return base_slots_[slot];
+        }
+    }
+    return NO_TERM;
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "column.h"
+
+class IndexFile;
+class IndexFileWriter;
+
+using TermId = uint32_t;
+
+// Словарь термов: каждое уникальное слово хранится один раз и получает стабильный целочисленный id.
+// Строки лежат в deque, поэтому string_view на них не инвалидируются при добавлении новых слов.
+// Словарь, открытый из файла индекса, читает слова и хеш-таблицу прямо из файла, а новые слова
+// хранит как обычно; их id продолжают id из файла.
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+    // При перемещении deque передаёт свои блоки целиком, строки остаются на месте и string_view на них верны
+    TermDictionary(TermDictionary&&) noexcept = default;
+    TermDictionary& operator=(TermDictionary&&) noexcept = default;
+
+    static TermDictionary Open(const IndexFile& file);
+
+    void Save(IndexFileWriter& writer) const;
+
+    // Возвращает id слова, добавляя его в словарь при первой встрече
+    TermId Intern(std::string_view word);
+
+    // Возвращает id слова или NO_TERM, если слово ни разу не встречалось
+    TermId Find(std::string_view word) const;
+
+    std::string_view GetWord(TermId term_id) const {
+        if (term_id < base_term_count_) {
+            const uint64_t first = base_word_offsets_[term_id];
+            return { base_word_chars_.Data() + first, static_cast<size_t>(base_word_offsets_[term_id + 1] - first) };
+        }
+        return words_[term_id - base_term_count_];
+    }
+
+    size_t Size() const {
+        return base_term_count_ + words_.size();
+    }
+
+private:
+    // термы из файла индекса: слова в формате CSR и хеш-таблица с открытой адресацией,
+    // в слотах которой лежат id термов или NO_TERM; число слотов — степень двойки
+    Column<uint64_t> base_word_offsets_;
+    Column<char> base_word_chars_;
+    Column<TermId> base_slots_;
+    TermId base_term_count_ = 0;
+
+    // термы, добавленные в памяти
+    std::deque<std::string> storage_;
+    std::vector<std::string_view> words_;
+    std::unordered_map<std::string_view, TermId> term_ids_;
+
+    TermId FindBase(std::string_view word) const;
+};
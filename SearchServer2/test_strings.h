@@ -2,15 +2,42 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <thread>
 
+#include "concurrent_search_server.h"
 #include "document.h"
+#include "durable_search_server.h"
+#include "dynamic_bitset.h"
+#include "index_file.h"
 #include "paginator.h"
+#include "posting_codec.h"
+#include "remote_sharded_search_server.h"
+#include "score_accumulator.h"
 #include "search_server.h"
+#include "shard_process.h"
+#include "sharded_search_server.h"
+#include "stop_word_set.h"
+#include "string_processing.h"
 #include "utility.h"
 
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 //ostream& operator<<(ostream& os, const DocumentStatus& ds) {
@@ -304,6 +331,1241 @@ void TestSearchServerCalcRelevance() {
     }
 }
 
+//   :      
+void TestSearchServerFreeze() {
+    SearchServer server("and in on"s);
+    server.AddDocument(0, "white cat and funny collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(1, "flurry cat flurry tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "lucky dog good eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(3, "lucky starling Eugene"s, DocumentStatus::BANNED, { 9 });
+
+    const auto expected = server.FindTopDocuments("flurry lucky -dog cat"s);
+    server.Freeze();
+    ASSERT(server.IsFrozen());
+    const auto frozen = server.FindTopDocuments("flurry lucky -dog cat"s);
+    ASSERT_EQUAL(frozen.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(frozen[i].id, expected[i].id);
+        ASSERT(abs(frozen[i].relevance - expected[i].relevance) < EPSILON);
+    }
+    {//    ,      
+        server.RemoveDocument(1);
+        ASSERT(server.IsFrozen());
+        server.AddDocument(4, "flurry tail"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(!server.IsFrozen());
+        const auto documents = server.FindTopDocuments("flurry"s);
+        ASSERT_EQUAL(documents.size(), 1);
+        ASSERT_EQUAL(documents[0].id, 4);
+    }
+}
+
+//   :      id
+void TestPostingCodec() {
+    mt19937 generator(42);
+    for (int step : { 1, 3, 1000, 1 << 20 }) {
+        vector<int> document_ids;
+        int document_id = 0;
+        for (size_t i = 0; i < POSTING_BLOCK_SIZE; ++i) {
+            document_id += uniform_int_distribution<int>(1, step)(generator);
+            document_ids.push_back(document_id);
+        }
+        for (size_t count : { size_t{ 1 }, size_t{ 5 }, POSTING_BLOCK_SIZE }) {
+            vector<uint32_t> data;
+            const PostingBlock block = EncodePostingBlock(document_ids.data(), count, data);
+            data.resize(data.size() + POSTING_BLOCK_PADDING, 0);
+            for (PostingDecoder decoder : { PostingDecoder::SCALAR, PostingDecoder::SSE2, PostingDecoder::AVX2 }) {
+                int decoded[POSTING_BLOCK_SIZE];
+                DecodePostingBlock(block, data.data(), decoded, decoder);
+                ASSERT(equal(document_ids.begin(), document_ids.begin() + count, decoded));
+            }
+        }
+    }
+}
+
+// ,          
+void TestSearchServerInvalidDocument() {
+    SearchServer server("and in on"s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    try {
+        server.AddDocument(2, "fluffy do\x12g"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Invalid word must be rejected"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 1u);
+    ASSERT(vector<int>(server.begin(), server.end()) == vector<int>{ 1 });
+    server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy"s).size(), 1u);
+}
+
+//   top_k:          k
+void TestSearchServerTopK() {
+    SearchServer server("and in on"s);
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, "cat"s + string(id % 7, 's') + " cat dog"s, DocumentStatus::ACTUAL, { id % 10 });
+    }
+    const auto all = server.FindTopDocuments("cat dog"s, DocumentStatus::ACTUAL, 1000);
+    ASSERT_EQUAL(all.size(), 100u);
+    for (size_t top_k : { 0, 1, 5, 17, 100 }) {
+        const auto seq = server.FindTopDocuments(execution::seq, "cat dog"s, DocumentStatus::ACTUAL, top_k);
+        const auto par = server.FindTopDocuments(execution::par, "cat dog"s, DocumentStatus::ACTUAL, top_k);
+        ASSERT_EQUAL(seq.size(), top_k);
+        ASSERT_EQUAL(par.size(), top_k);
+        for (size_t i = 0; i < top_k; ++i) {
+            ASSERT(abs(seq[i].relevance - all[i].relevance) < EPSILON && seq[i].rating == all[i].rating);
+            ASSERT(abs(par[i].relevance - all[i].relevance) < EPSILON && par[i].rating == all[i].rating);
+        }
+    }
+}
+
+//  WAND:          
+void TestSearchServerWand() {
+    mt19937 generator(7);
+    const vector<string> dictionary = { "cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "fluffy"s, "lucky"s, "good"s };
+    SearchServer server("and in on"s);
+    for (int id = 0; id < 1000; ++id) {
+        string text;
+        for (int i = 0; i < 6; ++i) {
+            text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)] + " "s;
+        }
+        server.AddDocument(id * 2, text, static_cast<DocumentStatus>(id % 3), { id % 13 });
+    }
+    const vector<string> queries = { "cat"s, "fluffy cat -dog"s, "lucky good eyes tail"s, "collar -cat -tail"s, "unknown"s };
+    for (int frozen = 0; frozen < 2; ++frozen) {
+        for (const string& query : queries) {
+            server.SetRetrievalAlgorithm(RetrievalAlgorithm::EXHAUSTIVE);
+            const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 10);
+            for (const RetrievalAlgorithm algorithm : { RetrievalAlgorithm::WAND, RetrievalAlgorithm::BLOCK_MAX_WAND }) {
+                server.SetRetrievalAlgorithm(algorithm);
+                const auto actual = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 10);
+                ASSERT_EQUAL(actual.size(), expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, query);
+                }
+            }
+        }
+        server.Freeze();
+    }
+}
+
+void TestScoreAccumulator() {
+    mt19937 generator(3);
+    const int ordinal_count = 1000;
+    //            ,   
+    ScoreAccumulator dense(ordinal_count, ordinal_count);
+    ScoreAccumulator sparse(ordinal_count, 4);
+    ASSERT(dense.IsDense());
+    ASSERT(!sparse.IsDense());
+    for (int i = 0; i < 3000; ++i) {
+        const int ordinal = uniform_int_distribution<int>(0, ordinal_count - 1)(generator);
+        dense.Add(ordinal, 0.5);
+        sparse.Add(ordinal, 0.5);
+    }
+    ASSERT(dense.Extract() == sparse.Extract());
+
+    ScoreAccumulator merged(ordinal_count, 0);
+    merged.Add(1, 1.0);
+    merged.Merge(dense);
+    dense.Add(1, 1.0);
+    ASSERT(merged.Extract() == dense.Extract());
+
+    SearchServer server("and"s);
+    for (int id = 0; id < 500; ++id) {
+        server.AddDocument(id, "cat dog tail collar eyes"s.substr(0, 3 + 4 * (id % 5)), DocumentStatus::ACTUAL, { id % 7 });
+    }
+    const string query = "cat dog tail collar eyes -tail"s;
+    const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+    const auto actual = server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 50);
+    ASSERT_EQUAL(actual.size(), expected.size());
+    //      ,     
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+        ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+    }
+}
+
+void TestDynamicBitset() {
+    DynamicBitset bits(130);
+    ASSERT_EQUAL(bits.Size(), 130u);
+    bits.Set(0);
+    bits.Set(64);
+    bits.Set(129);
+    ASSERT(bits.Test(0) && bits.Test(64) && bits.Test(129));
+    ASSERT(!bits.Test(1) && !bits.Test(63) && !bits.Test(128));
+    bits.Reset(64);
+    ASSERT(!bits.Test(64));
+    //         
+    bits.Resize(100);
+    bits.Resize(130);
+    ASSERT(!bits.Test(129));
+    ASSERT(bits.Test(0));
+
+    SearchServer server("and"s);
+    server.AddDocument(1, "rare common"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "rare"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "common"s, DocumentStatus::ACTUAL, { 1 });
+    for (const auto& documents : { server.FindTopDocuments("rare -common"s), server.FindTopDocuments(execution::par, "rare -common"s) }) {
+        ASSERT_EQUAL(documents.size(), 1u);
+        ASSERT_EQUAL(documents[0].id, 2);
+    }
+}
+
+void TestSearchServerInverseDocumentFreqCache() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "dog"s, DocumentStatus::ACTUAL, { 1 });
+    const uint64_t generation = server.GetIndexGeneration();
+    ASSERT(abs(server.FindTopDocuments("cat"s)[0].relevance - log(2.0)) < EPSILON);
+
+    // IDF    
+    server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(server.GetIndexGeneration() != generation);
+    ASSERT(abs(server.FindTopDocuments("cat"s)[0].relevance - log(3.0)) < EPSILON);
+    ASSERT(abs(server.FindTopDocuments("dog"s)[0].relevance - log(1.5)) < EPSILON);
+
+    SearchServer copy = server;
+    server.RemoveDocument(3);
+    ASSERT(abs(server.FindTopDocuments("cat"s)[0].relevance - log(2.0)) < EPSILON);
+    ASSERT(abs(copy.FindTopDocuments("cat"s)[0].relevance - log(3.0)) < EPSILON);
+
+    server.Freeze();
+    ASSERT(abs(server.FindTopDocuments(execution::par, "dog"s)[0].relevance - log(2.0)) < EPSILON);
+}
+
+void TestSearchServerStatusBitmaps() {
+    mt19937 generator(11);
+    const vector<string> dictionary = { "cat"s, "dog"s, "tail"s, "collar"s, "eyes"s };
+    SearchServer server("and"s);
+    for (int id = 0; id < 300; ++id) {
+        string text;
+        for (int i = 0; i < 4; ++i) {
+            text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)] + " "s;
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % DOCUMENT_STATUS_COUNT), { id % 11 });
+    }
+    for (int id = 0; id < 300; id += 9) {
+        server.RemoveDocument(id);
+    }
+    //               
+    for (int frozen = 0; frozen < 2; ++frozen) {
+        for (const string& query : { "cat dog"s, "tail -eyes"s, "collar -cat -dog"s }) {
+            for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+                const auto expected = server.FindTopDocuments(query, [status](int, DocumentStatus document_status, int) {
+                    return static_cast<int>(document_status) == status;
+                    }, 300);
+                const auto actual = server.FindTopDocuments(execution::par, query, static_cast<DocumentStatus>(status), 300);
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+                    ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+                }
+            }
+        }
+        server.Freeze();
+    }
+}
+
+void TestSearchServerAddDocuments() {
+    mt19937 generator(12);
+    const vector<string> dictionary = { "cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "and"s };
+    vector<string> texts;
+    for (int id = 0; id < 400; ++id) {
+        string text;
+        for (int i = 0; i < 5; ++i) {
+            text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)] + " "s;
+        }
+        texts.push_back(text);
+    }
+    vector<NewDocument> documents;
+    SearchServer expected_server("and"s);
+    for (int id = 0; id < 400; ++id) {
+        documents.push_back({ id * 2, texts[id], static_cast<DocumentStatus>(id % 2), { id % 9, 1 } });
+        expected_server.AddDocument(id * 2, texts[id], static_cast<DocumentStatus>(id % 2), { id % 9, 1 });
+    }
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat tail"s, DocumentStatus::ACTUAL, { 3 });
+    expected_server.AddDocument(1, "cat tail"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocuments(execution::par, documents);
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    for (const string& query : { "cat dog"s, "tail -eyes"s, "collar"s }) {
+        const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 500);
+        const auto actual = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 500);
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+        }
+    }
+    ASSERT(server.GetWordFrequencies(8) == expected_server.GetWordFrequencies(8));
+
+    //     ,   AddDocument:   
+    SearchServer partial("and"s);
+    const string bad_text = "bad\x12word"s;
+    const vector<NewDocument> with_bad_word = { { 1, "cat", DocumentStatus::ACTUAL, {} }, { 2, bad_text, DocumentStatus::ACTUAL, {} }, { 3, "dog", DocumentStatus::ACTUAL, {} } };
+    try {
+        partial.AddDocuments(execution::par, with_bad_word);
+        ASSERT_HINT(false, "invalid word must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(partial.GetDocumentCount(), 1u);
+    const vector<NewDocument> with_duplicate = { { 2, "dog", DocumentStatus::ACTUAL, {} }, { 1, "cat", DocumentStatus::ACTUAL, {} } };
+    try {
+        partial.AddDocuments(with_duplicate);
+        ASSERT_HINT(false, "duplicate id must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(partial.GetDocumentCount(), 2u);
+    ASSERT_EQUAL(partial.FindTopDocuments("dog"s).size(), 1u);
+}
+
+void TestSearchServerSegments() {
+    mt19937 generator(13);
+    const vector<string> dictionary = { "cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "fluffy"s };
+    SearchServer expected_server("and"s);
+    SearchServer server("and"s);
+    server.SetSegmentDocumentLimit(16);
+    for (int id = 0; id < 600; ++id) {
+        string text;
+        for (int i = 0; i < 5; ++i) {
+            text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)] + " "s;
+        }
+        expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 17 });
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 17 });
+    }
+    ASSERT(server.GetSegmentCount() > 1);
+    //       
+    for (const int id : { 3, 100, 101, 599 }) {
+        expected_server.RemoveDocument(id);
+        server.RemoveDocument(execution::par, id);
+    }
+    const SearchServer copy = server;
+    const vector<string> queries = { "cat"s, "fluffy dog -tail"s, "collar eyes -cat"s };
+    for (int frozen = 0; frozen < 2; ++frozen) {
+        for (const string& query : queries) {
+            const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+            for (const RetrievalAlgorithm algorithm : { RetrievalAlgorithm::EXHAUSTIVE, RetrievalAlgorithm::WAND, RetrievalAlgorithm::BLOCK_MAX_WAND }) {
+                server.SetRetrievalAlgorithm(algorithm);
+                for (const auto& actual : { server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20), copy.FindTopDocuments(query, DocumentStatus::ACTUAL, 20) }) {
+                    ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                    for (size_t i = 0; i < expected.size(); ++i) {
+                        ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+                        ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+                    }
+                }
+            }
+        }
+        server.Freeze();
+        ASSERT(server.IsFrozen());
+        ASSERT_EQUAL(server.GetSegmentCount(), 2u);
+    }
+}
+
+void TestSearchServerRemoveDocumentTombstones() {
+    SearchServer server("and"s);
+    server.SetSegmentDocumentLimit(4);
+    for (int id = 0; id < 10; ++id) {
+        server.AddDocument(id, "white cat "s + to_string(id), DocumentStatus::ACTUAL, { id });
+    }
+    //  0  5    , 9   
+    for (const int id : { 0, 5, 9 }) {
+        server.RemoveDocument(id);
+    }
+    const auto any_document = [](int, DocumentStatus, int) { return true; };
+    for (int frozen = 0; frozen < 2; ++frozen) {
+        for (const RetrievalAlgorithm algorithm : { RetrievalAlgorithm::EXHAUSTIVE, RetrievalAlgorithm::WAND, RetrievalAlgorithm::BLOCK_MAX_WAND }) {
+            server.SetRetrievalAlgorithm(algorithm);
+            for (const auto& found : { server.FindTopDocuments("cat"s, any_document, 20), server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 20) }) {
+                ASSERT_EQUAL(found.size(), 7u);
+                for (const Document& document : found) {
+                    ASSERT(document.id != 0 && document.id != 5 && document.id != 9);
+                }
+            }
+        }
+        //     
+        server.RemoveDocument(5);
+        server.Freeze();
+        ASSERT(server.IsFrozen());
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 7u);
+
+    //  id      ,      ;
+    //  id   
+    stringstream snapshot;
+    server.SaveSnapshot(snapshot);
+    SearchServer loaded = SearchServer::LoadSnapshot(snapshot);
+    for (SearchServer* current : { &server, &loaded }) {
+        current->RemoveDocument(3);
+        current->AddDocument(5, "white dog"s, DocumentStatus::ACTUAL, { 5 });
+        current->AddDocument(20, "white dog"s, DocumentStatus::ACTUAL, { 20 });
+        ASSERT_EQUAL(current->GetDocumentCount(), 8u);
+        ASSERT_EQUAL(current->FindTopDocuments("dog"s).size(), 2u);
+        try {
+            current->AddDocument(20, "white dog"s, DocumentStatus::ACTUAL, { 20 });
+            ASSERT_HINT(false, "live id must not be added twice"s);
+        }
+        catch (const invalid_argument&) {
+        }
+        ASSERT(get<0>(current->MatchDocument("white"s, 5)) == vector<string_view>{ "white"sv });
+        ASSERT(current->GetWordFrequencies(3).empty());
+        ASSERT(vector<int>(current->begin(), current->end()) == (vector<int>{ 1, 2, 4, 5, 6, 7, 8, 20 }));
+    }
+    //      
+    loaded.RemoveDocuments({ 1, 2, 4, 20 });
+    ASSERT_EQUAL(loaded.GetDocumentCount(), 4u);
+    ASSERT(vector<int>(loaded.begin(), loaded.end()) == (vector<int>{ 5, 6, 7, 8 }));
+}
+
+void TestSearchServerRemoveDocuments() {
+    SearchServer expected_server("and"s);
+    SearchServer server("and"s);
+    server.SetSegmentDocumentLimit(8);
+    for (int id = 0; id < 40; ++id) {
+        const string text = "cat "s + (id % 3 == 0 ? "dog "s : "tail "s) + to_string(id % 5);
+        expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+    }
+    //    id 
+    const vector<int> removed_ids = { 39, 3, 100, 7, 3, 12, 0, -1, 25 };
+    for (const int id : removed_ids) {
+        expected_server.RemoveDocument(id);
+    }
+    server.RemoveDocuments(execution::par, removed_ids);
+    server.RemoveDocuments({ 7 });
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    ASSERT(vector<int>(server.begin(), server.end()) == vector<int>(expected_server.begin(), expected_server.end()));
+    for (const string& query : { "cat"s, "dog -tail"s, "tail 1 2"s }) {
+        const auto expected = expected_server.FindTopDocuments(query);
+        const auto actual = server.FindTopDocuments(query);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+        }
+    }
+}
+
+void TestConcurrentSearchServer() {
+    ConcurrentSearchServer server("and"s);
+    const auto any_document = [](int, DocumentStatus, int) { return true; };
+    atomic<bool> done = false;
+    atomic<int> inconsistent_count = 0;
+    //   :     
+    vector<thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&] {
+            while (!done) {
+                const auto snapshot = server.GetSnapshot();
+                if (snapshot->FindTopDocuments("cat"s, any_document, 1000).size() != snapshot->GetDocumentCount()) {
+                    ++inconsistent_count;
+                }
+            }
+            });
+    }
+    for (int id = 0; id < 200; ++id) {
+        server.AddDocument(id, "cat "s + to_string(id), DocumentStatus::ACTUAL, { id });
+        if (id % 10 == 9) {
+            server.RemoveDocuments({ id - 9, id - 5 });
+        }
+    }
+    try {
+        server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "duplicate id must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    server.AddDocuments({ { 1000, "white cat"s, DocumentStatus::ACTUAL, { 1 } }, { 1001, "black cat"s, DocumentStatus::BANNED, { 2 } } });
+    done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(inconsistent_count.load(), 0);
+    //       
+    for (int i = 0; i < 2; ++i) {
+        server.Freeze();
+        const auto snapshot = server.GetSnapshot();
+        ASSERT_EQUAL(snapshot->GetDocumentCount(), 162u);
+        ASSERT(snapshot->IsFrozen());
+        ASSERT_EQUAL(snapshot->FindTopDocuments("cat"s, DocumentStatus::BANNED).size(), 1u);
+    }
+}
+
+void TestShardedSearchServer() {
+    mt19937 generator(17);
+    const vector<string> dictionary = { "cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "fluffy"s, "and"s };
+    SearchServer expected_server("and"s);
+    ShardedSearchServer server("and"s, 4);
+    vector<string> texts;
+    for (int id = 0; id < 300; ++id) {
+        string text;
+        for (int i = 0; i < 4; ++i) {
+            text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)] + " "s;
+        }
+        texts.push_back(text);
+    }
+    for (int id = 0; id < 100; ++id) {
+        expected_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 13 });
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 13 });
+    }
+    //    id 150:          
+    vector<NewDocument> documents;
+    for (int id = 100; id < 300; ++id) {
+        documents.push_back({ id == 200 ? 150 : id, texts[id], DocumentStatus::ACTUAL, { id % 13 } });
+    }
+    try {
+        server.AddDocuments(documents);
+        ASSERT_HINT(false, "duplicate id must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    for (int id = 100; id < 200; ++id) {
+        expected_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 13 });
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    expected_server.RemoveDocuments({ 5, 50, 150 });
+    server.RemoveDocuments({ 5, 50, 150 });
+
+    for (const string& query : { "cat"s, "fluffy dog -tail"s, "collar eyes cat"s }) {
+        const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 30);
+        const auto actual = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 30);
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+        }
+    }
+    ASSERT(get<0>(server.MatchDocument("cat dog"s, 7)) == get<0>(expected_server.MatchDocument("cat dog"s, 7)));
+    try {
+        server.FindTopDocuments("cat --dog"s);
+        ASSERT_HINT(false, "invalid query must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+#ifndef _WIN32
+void TestRemoteShardedSearchServer() {
+    const string socket_prefix = "/tmp/search_server_test_"s + to_string(getpid()) + "_"s;
+    vector<string> socket_paths;
+    vector<pid_t> pids;
+    for (int shard = 0; shard < 3; ++shard) {
+        socket_paths.push_back(socket_prefix + to_string(shard));
+        pids.push_back(StartShardProcess(socket_paths.back(), "and"s, shard % static_cast<int>(max(1u, thread::hardware_concurrency()))));
+    }
+    //    ,   
+    socket_paths.push_back(socket_prefix + "silent"s);
+    const int silent_fd = ListenUnixSocket(socket_paths.back());
+
+    SearchServer expected_server("and"s);
+    RemoteShardedSearchServer server(socket_paths, 200ms);
+    const vector<string> texts = { "white cat and collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s, "groomed starling eugene"s };
+    for (int id = 0; id < 40; ++id) {
+        // ,    ,  
+        if (ShardedSearchServer::GetShardIndex(id, socket_paths.size()) == 3) {
+            continue;
+        }
+        expected_server.AddDocument(id, texts[id % texts.size()], DocumentStatus::ACTUAL, { id });
+        server.AddDocument(id, texts[id % texts.size()], DocumentStatus::ACTUAL, { id });
+    }
+    for (const string& query : { "fluffy groomed cat"s, "cat -collar"s }) {
+        const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 10);
+        const auto actual = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 10);
+        ASSERT_EQUAL(server.GetRespondedShardCount(), 3u);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+        }
+    }
+    try {
+        server.FindTopDocuments("cat --dog"s);
+        ASSERT_HINT(false, "invalid query must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+
+    //   ,    
+    kill(pids[0], SIGKILL);
+    waitpid(pids[0], nullptr, 0);
+    ASSERT(!server.FindTopDocuments("cat"s).empty());
+    ASSERT_EQUAL(server.GetRespondedShardCount(), 2u);
+    pids[0] = StartShardProcess(socket_paths[0], "and"s);
+    server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(server.GetRespondedShardCount(), 3u);
+
+    server.Shutdown();
+    for (const pid_t pid : pids) {
+        waitpid(pid, nullptr, 0);
+    }
+    close(silent_fd);
+    unlink(socket_paths.back().c_str());
+}
+#endif
+
+#ifndef _WIN32
+void TestRemoteShardedSearchServerTruncatedResponse() {
+    //            ;
+    //     ,    ,  :
+    //         
+    const string socket_prefix = "/tmp/search_server_test_"s + to_string(getpid()) + "_truncated_"s;
+    const vector<string> socket_paths = { socket_prefix + "broken"s, socket_prefix + "healthy"s };
+    const vector<string> queries = { "cat"s, "dog"s };
+    const int broken_fd = ListenUnixSocket(socket_paths[0]);
+    ASSERT(broken_fd >= 0);
+    thread broken_shard([broken_fd, connection_count = queries.size() * 2 + 1] {
+        for (size_t i = 0; i < connection_count; ++i) {
+            const Deadline deadline = chrono::steady_clock::now() + 2s;
+            const int fd = accept(broken_fd, nullptr, nullptr);
+            uint8_t type = 0;
+            string request;
+            if (ReceiveMessage(fd, type, request, deadline)) {
+                MessageWriter response;
+                response.WriteUint8(static_cast<uint8_t>(ShardResponseStatus::OK));
+                SendMessage(fd, type, response.GetData(), deadline);
+            }
+            close(fd);
+        }
+    });
+    const pid_t pid = StartShardProcess(socket_paths[1], "and"s);
+
+    SearchServer expected_server("and"s);
+    RemoteShardedSearchServer server(socket_paths, 200ms);
+    for (int id = 0; id < 20; ++id) {
+        if (ShardedSearchServer::GetShardIndex(id, socket_paths.size()) == 1) {
+            expected_server.AddDocument(id, id % 2 == 0 ? "fluffy cat"s : "groomed dog"s, DocumentStatus::ACTUAL, { id });
+            server.AddDocument(id, id % 2 == 0 ? "fluffy cat"s : "groomed dog"s, DocumentStatus::ACTUAL, { id });
+        }
+    }
+    //    ,        
+    for (const string& query : queries) {
+        const auto expected = expected_server.FindTopDocuments(query);
+        const auto actual = server.FindTopDocuments(query);
+        ASSERT_EQUAL(server.GetRespondedShardCount(), 1u);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+        }
+    }
+
+    server.Shutdown();
+    broken_shard.join();
+    waitpid(pid, nullptr, 0);
+    close(broken_fd);
+    unlink(socket_paths[0].c_str());
+}
+#endif
+
+#ifndef _WIN32
+void TestShardRequestValidation() {
+    //        
+    int sockets[2];
+    ASSERT_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    const Deadline deadline = chrono::steady_clock::now() + 2s;
+    MessageWriter header;
+    header.WriteUint32(MAX_MESSAGE_SIZE + 1);
+    header.WriteUint8(static_cast<uint8_t>(ShardRequestType::ADD_DOCUMENT));
+    ASSERT_EQUAL(write(sockets[0], header.GetData().data(), header.GetData().size()), static_cast<ssize_t>(header.GetData().size()));
+    uint8_t type = 0;
+    string payload;
+    ASSERT(!ReceiveMessage(sockets[1], type, payload, deadline));
+    ASSERT(payload.capacity() < MAX_MESSAGE_SIZE);
+    ASSERT(SendMessage(sockets[0], 7, "payload"sv, deadline));
+    ASSERT(ReceiveMessage(sockets[1], type, payload, deadline));
+    ASSERT_EQUAL(static_cast<int>(type), 7);
+    ASSERT_EQUAL(payload, "payload"s);
+    close(sockets[0]);
+    close(sockets[1]);
+
+    const string socket_path = "/tmp/search_server_test_"s + to_string(getpid()) + "_validation"s;
+    //    cpu_set_t ,    
+    const pid_t pid = StartShardProcess(socket_path, "and"s, 1 << 20);
+    const auto call = [&deadline](int fd, ShardRequestType request_type, const MessageWriter& request) {
+        uint8_t response_type = 0;
+        string response;
+        ASSERT(SendMessage(fd, static_cast<uint8_t>(request_type), request.GetData(), deadline));
+        ASSERT(ReceiveMessage(fd, response_type, response, deadline));
+        return static_cast<ShardResponseStatus>(MessageReader(response).ReadUint8());
+    };
+    const int fd = ConnectUnixSocket(socket_path);
+    ASSERT(fd >= 0);
+    //   DocumentStatus    ,   
+    for (const uint8_t status : { uint8_t(4), uint8_t(255), uint8_t(0) }) {
+        MessageWriter request;
+        request.WriteInt32(1);
+        request.WriteString("cat"sv);
+        request.WriteUint8(status);
+        request.WriteUint32(0);
+        ASSERT(call(fd, ShardRequestType::ADD_DOCUMENT, request)
+            == (status == 0 ? ShardResponseStatus::OK : ShardResponseStatus::INVALID_ARGUMENT));
+    }
+    MessageWriter query;
+    query.WriteString("cat"sv);
+    query.WriteUint8(200);
+    query.WriteUint32(5);
+    query.WriteUint32(0);
+    ASSERT(call(fd, ShardRequestType::FIND_TOP_DOCUMENTS, query) == ShardResponseStatus::INVALID_ARGUMENT);
+    //       
+    ASSERT(write(fd, header.GetData().data(), header.GetData().size()) > 0);
+    ASSERT(!ReceiveMessage(fd, type, payload, deadline));
+    close(fd);
+
+    //  ,    ,    
+    MessageWriter huge_count;
+    huge_count.WriteUint32(0xFFFFFFFFu);
+    huge_count.WriteInt32(1);
+    MessageReader huge_count_reader(huge_count.GetData());
+    try {
+        huge_count_reader.ReadCount(sizeof(int32_t));
+        ASSERT_HINT(false, "count larger than the payload must be rejected"s);
+    }
+    catch (const runtime_error&) {
+    }
+    const int count_fd = ConnectUnixSocket(socket_path);
+    ASSERT(count_fd >= 0);
+    MessageWriter huge_ratings;
+    huge_ratings.WriteInt32(2);
+    huge_ratings.WriteString("dog"sv);
+    huge_ratings.WriteUint8(0);
+    huge_ratings.WriteUint32(0xFFFFFFFFu);
+    ASSERT(SendMessage(count_fd, static_cast<uint8_t>(ShardRequestType::ADD_DOCUMENT), huge_ratings.GetData(), deadline));
+    ASSERT(!ReceiveMessage(count_fd, type, payload, deadline));
+    close(count_fd);
+
+    const int shutdown_fd = ConnectUnixSocket(socket_path);
+    ASSERT(shutdown_fd >= 0);
+    ASSERT(call(shutdown_fd, ShardRequestType::SHUTDOWN, MessageWriter()) == ShardResponseStatus::OK);
+    close(shutdown_fd);
+    int exit_status = 0;
+    waitpid(pid, &exit_status, 0);
+    ASSERT(WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0);
+}
+#endif
+
+void TestSearchServerOpenMapped() {
+    const string path = "test_search_server.idx"s;
+    SearchServer server("and in"s);
+    server.SetSegmentDocumentLimit(8);
+    for (int id = 0; id < 60; ++id) {
+        const string text = "cat "s + (id % 3 == 0 ? "dog "s : "tail "s) + to_string(id % 7) + " and"s;
+        server.AddDocument(id * 2, text, id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id, 1 });
+    }
+    server.RemoveDocuments({ 0, 10, 30, 62 });
+    server.SaveIndexFile(path);
+    SearchServer mapped = SearchServer::OpenMapped(path);
+    //        ,      
+    const auto check_same = [](const SearchServer& expected_server, const SearchServer& actual_server) {
+        ASSERT_EQUAL(actual_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const string& query : { "cat"s, "dog -tail"s, "tail 1 2"s, "in fox"s }) {
+            for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+                const auto expected = expected_server.FindTopDocuments(query, status, 1000);
+                const auto actual = actual_server.FindTopDocuments(query, status, 1000);
+                ASSERT_EQUAL(actual.size(), expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL(actual[i].id, expected[i].id);
+                    ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+                    ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+                }
+            }
+        }
+    };
+    check_same(server, mapped);
+    ASSERT(vector<int>(mapped.begin(), mapped.end()) == vector<int>(server.begin(), server.end()));
+    ASSERT(mapped.GetWordFrequencies(4) == server.GetWordFrequencies(4));
+    ASSERT(get<0>(mapped.MatchDocument("dog tail 3"s, 6)) == get<0>(server.MatchDocument("dog tail 3"s, 6)));
+    ASSERT(get<1>(mapped.MatchDocument("cat"s, 8)) == DocumentStatus::BANNED);
+    ASSERT(mapped.GetWordFrequencies(10).empty());
+    ASSERT(mapped.IsFrozen());
+
+    //     
+    for (SearchServer* target : { &server, &mapped }) {
+        target->AddDocument(1, "white cat and fox"s, DocumentStatus::ACTUAL, { 5 });
+        target->AddDocument(3, "dog 3"s, DocumentStatus::ACTUAL, { 2 });
+        target->RemoveDocument(4);
+        target->RemoveDocuments({ 6, 8 });
+    }
+    check_same(server, mapped);
+    ASSERT(vector<int>(mapped.begin(), mapped.end()) == vector<int>(server.begin(), server.end()));
+    try {
+        mapped.AddDocument(12, "cat"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "duplicate id must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    remove(path.c_str());
+}
+
+void TestSearchServerSnapshot() {
+    SearchServer server("and in"s);
+    server.SetSegmentDocumentLimit(8);
+    for (int id = 0; id < 40; ++id) {
+        server.AddDocument(id, "cat "s + (id % 3 == 0 ? "dog "s : "tail "s) + to_string(id % 5), DocumentStatus::ACTUAL, { id });
+    }
+    server.RemoveDocuments({ 3, 17 });
+    stringstream snapshot;
+    server.SaveSnapshot(snapshot);
+    const string data = snapshot.str();
+
+    SearchServer loaded = SearchServer::LoadSnapshot(snapshot);
+    ASSERT_EQUAL(loaded.GetDocumentCount(), server.GetDocumentCount());
+    for (const string& query : { "cat"s, "dog -tail"s, "tail 1 2"s }) {
+        const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000);
+        const auto actual = loaded.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+        }
+    }
+    ASSERT(loaded.GetWordFrequencies(5) == server.GetWordFrequencies(5));
+    loaded.AddDocument(100, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(loaded.FindTopDocuments("white"s).size(), 1u);
+
+    //      
+    string corrupted = data;
+    corrupted[corrupted.find("tail"s)] = 'T';
+    for (const string& damaged : { data.substr(0, data.size() / 2), data.substr(0, data.size() - 1), corrupted }) {
+        istringstream input(damaged);
+        try {
+            SearchServer::LoadSnapshot(input);
+            ASSERT_HINT(false, "damaged snapshot must throw"s);
+        }
+        catch (const runtime_error&) {
+        }
+    }
+}
+
+void TestSearchServerIndexFileValidation() {
+    SearchServer server("and in"s);
+    server.SetSegmentDocumentLimit(8);
+    for (int id = 0; id < 40; ++id) {
+        server.AddDocument(id * 3, "cat "s + (id % 3 == 0 ? "dog "s : "tail "s) + to_string(id % 5), DocumentStatus::ACTUAL, { id });
+    }
+    stringstream snapshot;
+    server.SaveSnapshot(snapshot);
+    const string data = snapshot.str();
+
+    //  :        32 ,    32
+    vector<pair<IndexSection, string>> sections;
+    for (size_t position = 32;;) {
+        uint32_t section = 0;
+        uint64_t size = 0;
+        memcpy(&section, data.data() + position, sizeof(section));
+        memcpy(&size, data.data() + position + 8, sizeof(size));
+        if (section == static_cast<uint32_t>(IndexSection::END)) {
+            break;
+        }
+        sections.emplace_back(static_cast<IndexSection>(section), data.substr(position + 32, size));
+        position += 32 + (size + 31) / 32 * 32;
+    }
+    const auto get = [](const string& bytes, size_t index, auto value) {
+        memcpy(&value, bytes.data() + index * sizeof(value), sizeof(value));
+        return value;
+    };
+    const auto set = [](string& bytes, size_t index, auto value) {
+        memcpy(bytes.data() + index * sizeof(value), &value, sizeof(value));
+    };
+    //        
+    const auto load = [&sections](IndexSection changed_section, const function<void(string&)>& change) {
+        stringstream output;
+        IndexFileWriter writer(output);
+        for (const auto& [section, bytes] : sections) {
+            string changed = bytes;
+            if (section == changed_section) {
+                change(changed);
+            }
+            writer.WriteColumn(section, changed.data(), changed.size());
+        }
+        writer.Finish();
+        return SearchServer::LoadSnapshot(output);
+    };
+    //      ,        ,
+    //     :      ,
+    //   ordinal    
+    vector<int> document_ids;
+    for (int id = 0; id < 40; ++id) {
+        document_ids.push_back(id * 3);
+    }
+    const auto assert_damaged = [&load, &document_ids](IndexSection section, const function<void(string&)>& change, const string& hint) {
+        try {
+            SearchServer damaged = load(section, change);
+            stringstream output;
+            damaged.SaveSnapshot(output);
+            damaged.RemoveDocuments(document_ids);
+            ASSERT_HINT(false, hint);
+        }
+        catch (const runtime_error&) {
+        }
+    };
+
+    const SearchServer loaded = load(IndexSection::END, [](string&) {});
+    ASSERT_EQUAL(loaded.FindTopDocuments("dog"s).size(), server.FindTopDocuments("dog"s).size());
+
+    const uint32_t no_term = TermDictionary::NO_TERM;
+    assert_damaged(IndexSection::TERM_HASH_SLOTS, [&](string& bytes) {
+        bytes.append(sizeof(no_term), '\xFF');
+        }, "slot count must be a power of two"s);
+    assert_damaged(IndexSection::TERM_HASH_SLOTS, [&](string& bytes) {
+        for (size_t i = 0; i < bytes.size() / sizeof(no_term); ++i) {
+            if (get(bytes, i, no_term) != no_term) {
+                set(bytes, i, uint32_t{ 1000000 });
+                break;
+            }
+        }
+        }, "slot must hold an existing term"s);
+    assert_damaged(IndexSection::TERM_HASH_SLOTS, [&](string& bytes) {
+        bytes.assign(bytes.size(), '\0');
+        }, "hash table must have an empty slot"s);
+    assert_damaged(IndexSection::TERM_WORD_OFFSETS, [&](string& bytes) {
+        set(bytes, 1, get(bytes, 2, uint64_t{}) + 1);
+        }, "term offsets must not decrease"s);
+    assert_damaged(IndexSection::STOP_WORD_OFFSETS, [&](string& bytes) {
+        set(bytes, bytes.size() / sizeof(uint64_t) - 1, uint64_t{ 1000000 });
+        }, "stop word offsets must stay inside chars"s);
+    assert_damaged(IndexSection::TERM_DOCUMENT_COUNTS, [&](string& bytes) {
+        set(bytes, 0, -1);
+        }, "term document count must not be negative"s);
+    assert_damaged(IndexSection::DOCUMENT_ID_ORDINALS, [&](string& bytes) {
+        set(bytes, 0, 40);
+        }, "ordinal must be less than document count"s);
+    assert_damaged(IndexSection::TEXT_OFFSETS, [&](string& bytes) {
+        set(bytes, bytes.size() / sizeof(uint64_t) - 1, uint64_t{ 1000000 });
+        }, "text offsets must stay inside chars"s);
+    assert_damaged(IndexSection::FORWARD_TERM_FREQS, [&](string& bytes) {
+        set(bytes, 0, uint32_t{ 1000000 });
+        }, "forward index must hold existing terms"s);
+    assert_damaged(IndexSection::POSTING_OFFSETS, [&](string& bytes) {
+        set(bytes, 1, get(bytes, 1, uint64_t{}) + 1);
+        }, "posting offsets must match block sizes"s);
+    assert_damaged(IndexSection::POSTING_BLOCKS, [&](string& bytes) {
+        PostingBlock block = get(bytes, 0, PostingBlock{});
+        block.data_offset = 1u << 30;
+        set(bytes, 0, block);
+        }, "block data must stay inside packed ids"s);
+    assert_damaged(IndexSection::POSTING_BLOCKS, [&](string& bytes) {
+        //    32         
+        PostingBlock block = get(bytes, 0, PostingBlock{});
+        block.data_offset = numeric_limits<uint32_t>::max() - (block.size * block.bit_width + 31) / 32;
+        set(bytes, 0, block);
+        }, "block end must not wrap around"s);
+    assert_damaged(IndexSection::POSTING_BLOCKS, [&](string& bytes) {
+        PostingBlock block = get(bytes, 0, PostingBlock{});
+        block.bit_width = 32;
+        set(bytes, 0, block);
+        }, "bit width must fit a delta"s);
+    assert_damaged(IndexSection::POSTING_BLOCKS, [&](string& bytes) {
+        PostingBlock block = get(bytes, 0, PostingBlock{});
+        block.first_document_id += 40;
+        block.last_document_id += 40;
+        set(bytes, 0, block);
+        }, "posting must refer to an existing document"s);
+    assert_damaged(IndexSection::POSTING_BLOCKS, [&](string& bytes) {
+        PostingBlock block = get(bytes, 0, PostingBlock{});
+        ++block.last_document_id;
+        set(bytes, 0, block);
+        }, "block header must match its ids"s);
+
+    //           
+    const SearchServer lazy = load(IndexSection::POSTING_BLOCKS, [&](string& bytes) {
+        PostingBlock block = get(bytes, 0, PostingBlock{});
+        block.bit_width = 32;
+        set(bytes, 0, block);
+        });
+    ASSERT_EQUAL(lazy.FindTopDocuments(execution::par, "dog"s).size(), server.FindTopDocuments("dog"s).size());
+    try {
+        lazy.FindTopDocuments(execution::par, "cat"s);
+        ASSERT_HINT(false, "damaged postings must throw when read"s);
+    }
+    catch (const runtime_error&) {
+    }
+}
+
+void TestDurableSearchServer() {
+    const string directory = "test_durable_search_server"s;
+    filesystem::remove_all(directory);
+    SearchServer expected_server("and"s);
+    const auto check_same = [&expected_server](const SearchServer& server) {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const string& query : { "cat"s, "dog -tail"s, "tail 1 2"s }) {
+            const auto expected = expected_server.FindTopDocuments(query);
+            const auto actual = server.FindTopDocuments(query);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+                ASSERT(abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+            }
+        }
+    };
+    const auto add_documents = [&expected_server](DurableSearchServer& server, int first_id, int last_id) {
+        for (int id = first_id; id < last_id; ++id) {
+            const string text = "cat "s + (id % 3 == 0 ? "dog "s : "tail "s) + to_string(id % 5);
+            expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+            server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+        }
+    };
+    {
+        DurableSearchServer server(directory, "and"s);
+        add_documents(server, 0, 30);
+        server.RemoveDocuments({ 3, 4 });
+        expected_server.RemoveDocuments({ 3, 4 });
+        try {
+            server.AddDocument(5, "cat"s, DocumentStatus::ACTUAL, {});
+            ASSERT_HINT(false, "duplicate id must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+    //     ,    
+    {
+        DurableSearchServer server(directory, "and"s, WalDurability::BATCHED);
+        check_same(server.GetServer());
+        ASSERT_EQUAL(server.GetLastSequence(), 32u);
+        server.Checkpoint();
+        add_documents(server, 30, 40);
+        server.RemoveDocument(7);
+        expected_server.RemoveDocument(7);
+    }
+    //      
+    {
+        ofstream(directory + "/wal"s, ios::binary | ios::app) << "\x10\x00\x00"s;
+    }
+    {
+        DurableSearchServer server(directory, "ignored"s, WalDurability::OFF);
+        check_same(server.GetServer());
+        ASSERT_EQUAL(server.GetLastSequence(), 43u);
+        add_documents(server, 40, 45);
+    }
+    //    fsync     
+    {
+        DurableSearchServer server(directory, "and"s);
+        check_same(server.GetServer());
+        vector<thread> writers;
+        for (int thread_index = 0; thread_index < 4; ++thread_index) {
+            writers.emplace_back([&server, thread_index] {
+                for (int id = 100 + thread_index * 10; id < 110 + thread_index * 10; ++id) {
+                    server.AddDocument(id, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+                }
+                });
+        }
+        for (thread& writer : writers) {
+            writer.join();
+        }
+    }
+    {
+        DurableSearchServer server(directory, "and"s);
+        ASSERT_EQUAL(server.GetServer().GetDocumentCount(), expected_server.GetDocumentCount() + 40);
+    }
+    //    ,    DocumentStatus,     
+    filesystem::remove_all(directory);
+    filesystem::create_directory(directory);
+    {
+        WriteAheadLog log(directory + "/wal"s, 1, WalDurability::OFF);
+        log.AppendAddDocuments({ { 1, "cat"sv, static_cast<DocumentStatus>(200), { 1 } } });
+    }
+    try {
+        SearchServer server("and"s);
+        WriteAheadLog::Replay(directory + "/wal"s, 0, server);
+        ASSERT_HINT(false, "invalid status in the log must throw"s);
+    }
+    catch (const runtime_error&) {
+    }
+    filesystem::remove_all(directory);
+}
+
+void TestSplitIntoWords() {
+    // :        
+    const auto split_reference = [](const string& text, size_t& first_invalid_word) {
+        vector<string_view> words;
+        size_t word_start = 0;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i == text.size() || text[i] == ' ') {
+                if (i > word_start) {
+                    words.push_back(string_view(text).substr(word_start, i - word_start));
+                }
+                word_start = i + 1;
+            }
+        }
+        first_invalid_word = find_if(words.begin(), words.end(), [](string_view word) {
+            return any_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
+            }) - words.begin();
+        return words;
+    };
+    mt19937 generator(42);
+    const string alphabet = "ab  \x01\x1f\x7f\xe0\xff"s;
+    for (int step = 0; step < 2000; ++step) {
+        string text(uniform_int_distribution<size_t>(0, 100)(generator), ' ');
+        //   ,        
+        for (char& c : text) {
+            c = alphabet[uniform_int_distribution<size_t>(0, step % 2 == 0 ? 3 : alphabet.size() - 1)(generator)];
+        }
+        size_t expected_invalid_word = 0;
+        const vector<string_view> expected = split_reference(text, expected_invalid_word);
+        for (Tokenizer tokenizer : { Tokenizer::SCALAR, Tokenizer::SSE2, Tokenizer::AVX2 }) {
+            size_t invalid_word = 0;
+            ASSERT(SplitIntoWords(text, invalid_word, tokenizer) == expected);
+            ASSERT_EQUAL(invalid_word, expected_invalid_word);
+        }
+        ASSERT(SplitIntoWords(text) == expected);
+    }
+}
+
+void TestWordRange() {
+    mt19937 generator(7);
+    const string alphabet = "abcdefgh \x01\xe0"s;
+    for (int step = 0; step < 1000; ++step) {
+        //        32 
+        string text(uniform_int_distribution<size_t>(0, 200)(generator), ' ');
+        for (char& c : text) {
+            c = alphabet[uniform_int_distribution<size_t>(0, step % 2 == 0 ? 8 : alphabet.size() - 1)(generator)];
+        }
+        for (Tokenizer tokenizer : { Tokenizer::SCALAR, Tokenizer::SSE2, Tokenizer::AVX2 }) {
+            const WordRange range(text, tokenizer);
+            vector<string_view> words;
+            for (auto it = range.begin(); it != range.end(); ++it) {
+                const bool is_valid = none_of(it->begin(), it->end(), [](char c) { return c >= '\0' && c < ' '; });
+                ASSERT_EQUAL(it.IsValid(), is_valid);
+                words.push_back(*it);
+            }
+            ASSERT(words == SplitIntoWords(text));
+            ASSERT_EQUAL(static_cast<size_t>(distance(range.begin(), range.end())), words.size());
+        }
+    }
+
+    const string text = "  cat   dog cat "s;
+    const WordRange range(text);
+    auto it = range.begin();
+    const auto first = it++;
+    ASSERT_EQUAL(*first, "cat"sv);
+    ASSERT_EQUAL(*it, "dog"sv);
+    ASSERT(first == range.begin());
+    ASSERT(range.begin() != range.end());
+    const string spaces = "    "s;
+    const WordRange empty(spaces);
+    ASSERT(empty.begin() == empty.end());
+    ASSERT_EQUAL(MakeUniqueNonEmptyStrings(range).size(), 2u);
+}
+
+void TestStopWordSet() {
+    ASSERT(!StopWordSet().Contains("and"sv));
+    ASSERT_EQUAL(StopWordSet().Size(), 0u);
+
+    mt19937 generator(24);
+    //  ,         
+    const auto random_word = [&generator] {
+        const size_t length = uniform_int_distribution<size_t>(0, 5)(generator) == 0
+            ? uniform_int_distribution<size_t>(1, 80)(generator) : uniform_int_distribution<size_t>(1, 8)(generator);
+        string word(length, 'a');
+        for (char& c : word) {
+            c = "abc\xe0"[uniform_int_distribution<int>(0, 3)(generator)];
+        }
+        return word;
+    };
+    for (int step = 0; step < 50; ++step) {
+        set<string, less<>> words;
+        const size_t word_count = uniform_int_distribution<size_t>(1, 500)(generator);
+        while (words.size() < word_count) {
+            words.insert(random_word());
+        }
+        const StopWordSet stop_words(words);
+        ASSERT_EQUAL(stop_words.Size(), words.size());
+        size_t index = 0;
+        for (const string& word : words) {
+            ASSERT_EQUAL(stop_words.GetWord(index++), word);
+        }
+        for (const string& word : words) {
+            ASSERT(stop_words.Contains(word));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            const string word = random_word();
+            ASSERT_EQUAL(stop_words.Contains(word), words.count(word) > 0);
+        }
+    }
+}
+
+void TestSearchServerQueryCache() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "dog"s, DocumentStatus::ACTUAL, { 1 });
+    // ,    ,   ,       
+    ASSERT(server.FindTopDocuments("cat dog"s).size() == 1);
+    server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(server.FindTopDocuments("cat dog"s).size() == 2);
+    ASSERT(server.FindTopDocuments("cat -dog"s).size() == 1);
+    server.RemoveDocument(2);
+    ASSERT(server.FindTopDocuments("cat -dog"s).empty());
+
+    //    
+    for (int i = 0; i < 2; ++i) {
+        try {
+            server.FindTopDocuments("dog --cat"s);
+            ASSERT_HINT(false, "invalid query must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+
+    //          
+    const auto same_documents = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& l, const Document& r) {
+            return l.id == r.id && l.rating == r.rating && abs(l.relevance - r.relevance) < EPSILON;
+            });
+    };
+    mt19937 generator(25);
+    const vector<string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "and"s, "-cat"s, "-bird"s };
+    const auto random_text = [&](size_t word_count) {
+        string text;
+        for (size_t i = 0; i < word_count; ++i) {
+            text += words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        return text;
+    };
+    vector<string> queries;
+    for (int i = 0; i < 30; ++i) {
+        queries.push_back(random_text(3));
+    }
+    for (size_t capacity : { 0, 1, 16, 1024 }) {
+        SearchServer cached("and"s);
+        SearchServer uncached("and"s);
+        cached.SetQueryCacheCapacity(capacity);
+        uncached.SetQueryCacheCapacity(0);
+        for (int step = 0; step < 300; ++step) {
+            if (step % 20 == 0) {
+                string text = random_text(4);
+                replace(text.begin(), text.end(), '-', 'x');
+                cached.AddDocument(step, text, DocumentStatus::ACTUAL, { step % 7 });
+                uncached.AddDocument(step, text, DocumentStatus::ACTUAL, { step % 7 });
+            }
+            if (step % 50 == 49) {
+                cached.RemoveDocument(step - 29);
+                uncached.RemoveDocument(step - 29);
+            }
+            const string& query = queries[uniform_int_distribution<size_t>(0, queries.size() - 1)(generator)];
+            ASSERT(same_documents(cached.FindTopDocuments(query), uncached.FindTopDocuments(query)));
+        }
+
+        //     
+        vector<vector<Document>> expected;
+        for (const string& query : queries) {
+            expected.push_back(uncached.FindTopDocuments(query));
+        }
+        vector<thread> threads;
+        atomic<int> mismatches = 0;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 500; ++i) {
+                    const size_t index = (i * 7 + t) % queries.size();
+                    if (!same_documents(cached.FindTopDocuments(execution::par, queries[index]), expected[index])) {
+                        ++mismatches;
+                    }
+                }
+                });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        ASSERT_EQUAL(mismatches.load(), 0);
+    }
+}
+
 
 
 //  TestSearchServer      
@@ -316,6 +1578,34 @@ void TestSearchServerStrings() {
     RUN_TEST(TestSearchServerPredictate);
     RUN_TEST(TestSearchServerMinus);
     RUN_TEST(TestSearchServerCalcRelevance);
+    RUN_TEST(TestSearchServerFreeze);
+    RUN_TEST(TestPostingCodec);
+    RUN_TEST(TestSearchServerInvalidDocument);
+    RUN_TEST(TestSearchServerTopK);
+    RUN_TEST(TestSearchServerWand);
+    RUN_TEST(TestScoreAccumulator);
+    RUN_TEST(TestDynamicBitset);
+    RUN_TEST(TestSearchServerInverseDocumentFreqCache);
+    RUN_TEST(TestSearchServerStatusBitmaps);
+    RUN_TEST(TestSearchServerAddDocuments);
+    RUN_TEST(TestSearchServerSegments);
+    RUN_TEST(TestSearchServerRemoveDocumentTombstones);
+    RUN_TEST(TestSearchServerRemoveDocuments);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestShardedSearchServer);
+#ifndef _WIN32
+    RUN_TEST(TestRemoteShardedSearchServer);
+    RUN_TEST(TestRemoteShardedSearchServerTruncatedResponse);
+    RUN_TEST(TestShardRequestValidation);
+#endif
+    RUN_TEST(TestSearchServerOpenMapped);
+    RUN_TEST(TestSearchServerSnapshot);
+    RUN_TEST(TestSearchServerIndexFileValidation);
+    RUN_TEST(TestDurableSearchServer);
+    RUN_TEST(TestSplitIntoWords);
+    RUN_TEST(TestWordRange);
+    RUN_TEST(TestStopWordSet);
+    RUN_TEST(TestSearchServerQueryCache);
 
 }
 
@@ -0,0 +1,125 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Хранит k лучших из просмотренных значений. Куча упорядочена так, что в вершине лежит худший
+// из отобранных: новое значение сравнивается только с ним, поэтому Push стоит O(log k).
+template <typename T, typename Compare>
+class TopKCollector {
+public:
+    // better(lhs, rhs) == true, если lhs должен стоять в выдаче раньше rhs
+    TopKCollector(size_t k, Compare better)
+        : k_(k)
+        , better_(better) {
+        heap_.reserve(k);
+    }
+
+    void Push(T value) {
+        if (heap_.size() < k_) {
+            heap_.push_back(std::move(value));
+            std::push_heap(heap_.begin(), heap_.end(), better_);
+        }
+        else if (k_ > 0 && better_(value, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), better_);
+            heap_.back() = std::move(value);
+            std::push_heap(heap_.begin(), heap_.end(), better_);
+        }
+    }
+
+    bool IsFull() const {
+        return heap_.size() >= k_;
+    }
+
+    // Худшее из отобранных значений; вызывать только для непустого набора
+    const T& GetWorst() const {
+        return heap_.front();
+    }
+
+    void Merge(TopKCollector&& other) {
+        for (T& value : other.heap_) {
+            Push(std::move(value));
+        }
+        other.heap_.clear();
+    }
+
+    // Возвращает отобранные значения, начиная с лучшего
+    std::vector<T> Extract() {
+        std::sort_heap(heap_.begin(), heap_.end(), better_);
+        return std::move(heap_);
+    }
+
+private:
+    size_t k_;
+    Compare better_;
+    std::vector<T> heap_;
+};
+
+// Отбирает k лучших значений без полной сортировки. При параллельной политике каждый поток
+// отбирает лучшие в своей части массива в собственную кучу, затем кучи сливаются.
+template <typename ExecutionPolicy, typename T, typename Compare>
+std::vector<T> SelectTopK(ExecutionPolicy&& exec_policy, std::vector<T> values, size_t k, Compare better) {
+    if (values.size() <= k) {
+        std::sort(exec_policy, values.begin(), values.end(), better);
+        return values;
+    }
+
+    constexpr bool is_sequenced = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+    const size_t chunk_count = is_sequenced ? 1
+        : std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), values.size() / std::max<size_t>(k, 1)));
+
+    std::vector<TopKCollector<T, Compare>> collectors(chunk_count, TopKCollector<T, Compare>(k, better));
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    const size_t chunk_size = (values.size() + chunk_count - 1) / chunk_count;
+    std::for_each(exec_policy, chunks.begin(), chunks.end(),
+        [&](size_t chunk) {
+            const size_t first = chunk * chunk_size;
+            const size_t last = std::min(values.size(), first + chunk_size);
+            for (size_t i = first; i < last; ++i) {
+                collectors[chunk].Push(std::move(values[i]));
+            }
+        });
+
+    for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+        collectors.front().Merge(std::move(collectors[chunk]));
+    }
+    return collectors.front().Extract();
+}
+
+// Сливает списки, каждый из которых упорядочен по better, и возвращает k лучших значений.
+// Куча хранит по одному текущему значению от каждого списка, поэтому слияние стоит O(k log m) для m списков.
+template <typename T, typename Compare>
+std::vector<T> MergeTopK(std::vector<std::vector<T>> sorted_lists, size_t k, Compare better) {
+    // позиции (список, номер значения); в вершине кучи лучшее из текущих значений
+    using Position = std::pair<size_t, size_t>;
+    const auto is_worse = [&sorted_lists, &better](const Position& lhs, const Position& rhs) {
+        return better(sorted_lists[rhs.first][rhs.second], sorted_lists[lhs.first][lhs.second]);
+    };
+    std::vector<Position> heap;
+    for (size_t list = 0; list < sorted_lists.size(); ++list) {
+        if (!sorted_lists[list].empty()) {
+            heap.emplace_back(list, 0);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), is_worse);
+
+    std::vector<T> result;
+    while (result.size() < k && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), is_worse);
+        auto [list, index] = heap.back();
+        result.push_back(std::move(sorted_lists[list][index]));
+        if (++index < sorted_lists[list].size()) {
+            heap.back() = { list, index };
+            std::push_heap(heap.begin(), heap.end(), is_worse);
+        }
+        else {
+            heap.pop_back();
+        }
+    }
+    return result;
+}
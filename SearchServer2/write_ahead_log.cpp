@@ -0,0 +1,415 @@
+﻿#include "write_ahead_log.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "index_file.h"
+#include "shard_protocol.h"
+
+#ifdef _WIN32
+#include <filesystem>
+
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals::string_literals;
+
+static constexpr char WAL_MAGIC[8] = { 'S', 'R', 'C', 'H', 'W', 'A', 'L', '\0' };
+static constexpr uint32_t WAL_VERSION = 1;
+static constexpr uint32_t WAL_BYTE_ORDER = 0x01020304;
+
+struct WalFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+};
+
+struct WalRecordHeader {
+    uint32_t size;
+    uint32_t type;
+    uint64_t sequence;
+    uint64_t checksum;
+};
+
+static int OpenLogFile(const std::string& path) {
+#ifdef _WIN32
+    const int fd = _open(path.c_str(), _O_RDWR | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("cannot open write-ahead log "s + path);
+    }
+    return fd;
+}
+
+static void CloseFile(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+static void WriteFile(int fd, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        const int written = _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, INT_MAX)));
+#else
+        const ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (written <= 0) {
+            throw std::runtime_error("cannot write to write-ahead log"s);
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+static void SyncFile(int fd) {
+#ifdef _WIN32
+    const bool is_synced = _commit(fd) == 0;
+#else
+    const bool is_synced = fsync(fd) == 0;
+#endif
+    if (!is_synced) {
+        throw std::runtime_error("cannot sync write-ahead log"s);
+    }
+}
+
+static void ResizeFile(int fd, uint64_t size) {
+#ifdef _WIN32
+    const bool is_resized = _chsize_s(fd, static_cast<long long>(size)) == 0;
+#else
+    const bool is_resized = ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+    if (!is_resized) {
+        throw std::runtime_error("cannot truncate write-ahead log"s);
+    }
+}
+
+static uint64_t GetFileSize(int fd) {
+#ifdef _WIN32
+    const long long size = _lseeki64(fd, 0, SEEK_END);
+#else
+    const off_t size = lseek(fd, 0, SEEK_END);
+#endif
+    if (size < 0) {
+        throw std::runtime_error("cannot read write-ahead log size"s);
+    }
+    return static_cast<uint64_t>(size);
+}
+
+void SyncPath(const std::string& path) {
+#ifdef _WIN32
+    // переименование в NTFS журналируется самой файловой системой, каталоги сбрасывать не нужно
+    if (std::filesystem::is_directory(path)) {
+        return;
+    }
+    const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+#else
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("cannot open "s + path);
+    }
+    try {
+        SyncFile(fd);
+    }
+    catch (const std::runtime_error&) {
+        CloseFile(fd);
+        throw std::runtime_error("cannot sync "s + path);
+    }
+    CloseFile(fd);
+}
+
+static WalFileHeader MakeFileHeader() {
+    WalFileHeader header{};
+    std::memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+    header.version = WAL_VERSION;
+    header.byte_order = WAL_BYTE_ORDER;
+    return header;
+}
+
+// Сумма по заголовку с обнулённым полем суммы и по нагрузке
+static uint64_t ComputeRecordChecksum(WalRecordHeader header, std::string_view payload) {
+    header.checksum = 0;
+    return ComputeChecksum(payload.data(), payload.size(), ComputeChecksum(&header, sizeof(header)));
+}
+
+void WriteAheadLog::ApplyRecord(uint32_t type, std::string_view payload, SearchServer& server) {
+    MessageReader reader(payload);
+    if (type == static_cast<uint32_t>(RecordType::ADD_DOCUMENTS)) {
+        // наименьшая запись документа: id, длина текста, статус и число рейтингов
+        std::vector<NewDocument> documents(reader.ReadCount(sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t)));
+        for (NewDocument& document : documents) {
+            document.id = reader.ReadInt32();
+            document.text = reader.ReadString();
+            const uint8_t status = reader.ReadUint8();
+            // сумма сходится и у записи, собранной вручную, а статус служит индексом битовой карты
+            if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+                throw std::runtime_error("damaged write-ahead log: invalid document status "s + std::to_string(status));
+            }
+            document.status = static_cast<DocumentStatus>(status);
+            document.ratings.resize(reader.ReadCount(sizeof(int32_t)));
+            for (int& rating : document.ratings) {
+                rating = reader.ReadInt32();
+            }
+        }
+        try {
+            server.AddDocuments(documents);
+        }
+        catch (const std::invalid_argument&) {
+            // изменение было отвергнуто и при первом выполнении — с тем же результатом
+        }
+    }
+    else if (type == static_cast<uint32_t>(RecordType::REMOVE_DOCUMENTS)) {
+        std::vector<int> document_ids(reader.ReadCount(sizeof(int32_t)));
+        for (int& document_id : document_ids) {
+            document_id = reader.ReadInt32();
+        }
+        server.RemoveDocuments(document_ids);
+    }
+    else {
+        throw std::runtime_error("unknown write-ahead log record type "s + std::to_string(type));
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, uint64_t next_sequence, WalDurability durability,
+    std::chrono::milliseconds sync_interval)
+    : fd_(OpenLogFile(path))
+    , durability_(durability)
+    , sync_interval_(sync_interval)
+    , last_sequence_(next_sequence - 1)
+    , durable_sequence_(next_sequence - 1) {
+    try {
+        size_ = GetFileSize(fd_);
+        if (size_ == 0) {
+            const WalFileHeader header = MakeFileHeader();
+            WriteFile(fd_, reinterpret_cast<const char*>(&header), sizeof(header));
+            size_ = sizeof(header);
+        }
+        // повторённые записи могли остаться только в кэше ОС, если сервер упал в режиме OFF
+        if (durability_ != WalDurability::OFF) {
+            SyncFile(fd_);
+        }
+    }
+    catch (const std::runtime_error&) {
+        CloseFile(fd_);
+        throw;
+    }
+    if (durability_ == WalDurability::BATCHED) {
+        sync_thread_ = std::thread(&WriteAheadLog::RunBackgroundSync, this);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard guard(mutex_);
+        stop_syncing_ = true;
+    }
+    sync_condition_.notify_all();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
+    }
+    if (durability_ != WalDurability::OFF) {
+        try {
+            SyncFile(fd_);
+        }
+        catch (const std::runtime_error&) {
+        }
+    }
+    CloseFile(fd_);
+}
+
+uint64_t WriteAheadLog::Replay(const std::string& path, uint64_t after_sequence, SearchServer& server) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return after_sequence;
+    }
+    const std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+
+    uint64_t sequence = after_sequence;
+    size_t valid_size = 0;
+    if (data.size() >= sizeof(WalFileHeader)) {
+        const WalFileHeader expected_header = MakeFileHeader();
+        if (std::memcmp(data.data(), &expected_header, sizeof(expected_header)) != 0) {
+            throw std::runtime_error(path + " is not a write-ahead log of this version"s);
+        }
+        valid_size = sizeof(WalFileHeader);
+        while (data.size() - valid_size >= sizeof(WalRecordHeader)) {
+            WalRecordHeader header;
+            std::memcpy(&header, data.data() + valid_size, sizeof(header));
+            if (data.size() - valid_size - sizeof(header) < header.size) {
+                break;
+            }
+            const std::string_view payload(data.data() + valid_size + sizeof(header), header.size);
+            if (ComputeRecordChecksum(header, payload) != header.checksum) {
+                break;
+            }
+            valid_size += sizeof(header) + header.size;
+            if (header.sequence > after_sequence) {
+                ApplyRecord(header.type, payload, server);
+            }
+            sequence = std::max(sequence, header.sequence);
+        }
+    }
+    if (valid_size < data.size()) {
+        // хвост от записи, которую сбой оборвал на середине
+        const int fd = OpenLogFile(path);
+        try {
+            ResizeFile(fd, valid_size);
+            SyncFile(fd);
+        }
+        catch (const std::runtime_error&) {
+            CloseFile(fd);
+            throw;
+        }
+        CloseFile(fd);
+    }
+    return sequence;
+}
+
+uint64_t WriteAheadLog::AppendAddDocuments(const std::vector<NewDocument>& documents) {
+    MessageWriter payload;
+    payload.WriteUint32(static_cast<uint32_t>(documents.size()));
+    for (const NewDocument& document : documents) {
+        payload.WriteInt32(document.id);
+        payload.WriteString(document.text);
+        payload.WriteUint8(static_cast<uint8_t>(document.status));
+        payload.WriteUint32(static_cast<uint32_t>(document.ratings.size()));
+        for (const int rating : document.ratings) {
+            payload.WriteInt32(rating);
+        }
+    }
+    return Append(RecordType::ADD_DOCUMENTS, payload.GetData());
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocuments(const std::vector<int>& document_ids) {
+    MessageWriter payload;
+    payload.WriteUint32(static_cast<uint32_t>(document_ids.size()));
+    for (const int document_id : document_ids) {
+        payload.WriteInt32(document_id);
+    }
+    return Append(RecordType::REMOVE_DOCUMENTS, payload.GetData());
+}
+
+uint64_t WriteAheadLog::Append(RecordType type, const std::string& payload) {
+    WalRecordHeader header{};
+    header.size = static_cast<uint32_t>(payload.size());
+    header.type = static_cast<uint32_t>(type);
+    std::string record(sizeof(header), '\0');
+    record += payload;
+
+    std::lock_guard guard(mutex_);
+    if (sync_error_) {
+        std::rethrow_exception(std::exchange(sync_error_, nullptr));
+    }
+    header.sequence = last_sequence_ + 1;
+    header.checksum = ComputeRecordChecksum(header, payload);
+    std::memcpy(record.data(), &header, sizeof(header));
+    try {
+        WriteFile(fd_, record.data(), record.size());
+    }
+    catch (const std::runtime_error&) {
+        // оборванная запись скрыла бы от повтора все следующие
+        ResizeFile(fd_, size_);
+        throw;
+    }
+    size_ += record.size();
+    last_sequence_ = header.sequence;
+    return last_sequence_;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence) {
+    if (durability_ != WalDurability::PER_WRITE) {
+        return;
+    }
+    std::unique_lock lock(mutex_);
+    SyncUpTo(lock, sequence);
+}
+
+void WriteAheadLog::Sync() {
+    std::unique_lock lock(mutex_);
+    SyncUpTo(lock, last_sequence_);
+}
+
+void WriteAheadLog::Truncate() {
+    std::unique_lock lock(mutex_);
+    sync_condition_.wait(lock, [this] {
+        return !is_syncing_;
+        });
+    const WalFileHeader header = MakeFileHeader();
+    ResizeFile(fd_, 0);
+    size_ = 0;
+    WriteFile(fd_, reinterpret_cast<const char*>(&header), sizeof(header));
+    size_ = sizeof(header);
+    SyncFile(fd_);
+    durable_sequence_ = last_sequence_;
+}
+
+uint64_t WriteAheadLog::GetLastSequence() const {
+    std::lock_guard guard(mutex_);
+    return last_sequence_;
+}
+
+// fsync выполняется без блокировки: тем временем другие потоки дописывают следующие записи
+void WriteAheadLog::SyncUpTo(std::unique_lock<std::mutex>& lock, uint64_t sequence) {
+    while (durable_sequence_ < sequence) {
+        if (is_syncing_) {
+            sync_condition_.wait(lock);
+            continue;
+        }
+        is_syncing_ = true;
+        const uint64_t target_sequence = last_sequence_;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            SyncFile(fd_);
+        }
+        catch (const std::runtime_error&) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        is_syncing_ = false;
+        if (!error) {
+            durable_sequence_ = std::max(durable_sequence_, target_sequence);
+        }
+        sync_condition_.notify_all();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void WriteAheadLog::RunBackgroundSync() {
+    std::unique_lock lock(mutex_);
+    while (!stop_syncing_) {
+        sync_condition_.wait_for(lock, sync_interval_, [this] {
+            return stop_syncing_;
+            });
+        try {
+            SyncUpTo(lock, last_sequence_);
+        }
+        catch (const std::runtime_error&) {
+            sync_error_ = std::current_exception();
+        }
+    }
+}
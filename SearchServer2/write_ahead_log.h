@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+// Когда записи журнала сбрасываются на диск
+enum class WalDurability {
+    // изменение завершается после fsync своей записи; одновременные изменения делят один fsync
+    PER_WRITE,
+    // фоновый fsync раз в интервал: при сбое машины теряется не больше интервала последних изменений
+    BATCHED,
+    // без fsync: записи переживают падение процесса, но не сбой машины
+    OFF,
+};
+
+// Сбрасывает на диск содержимое файла или каталога (после переименования файла в нём)
+void SyncPath(const std::string& path);
+
+// Журнал упреждающей записи изменений SearchServer. Файл — заголовок и последовательность записей:
+// размер нагрузки, тип, номер записи, контрольная сумма FNV-1a и нагрузка в кодировке MessageWriter.
+// Номера записей растут на единицу и продолжаются после очистки журнала, поэтому по номеру,
+// сохранённому вместе со снимком сервера, видно, какие записи в снимок уже вошли.
+class WriteAheadLog {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_SYNC_INTERVAL{ 10 };
+
+    // Открывает журнал для дописывания, создавая его при необходимости; next_sequence — номер следующей записи.
+    // Бросает std::runtime_error, если файл не открывается.
+    WriteAheadLog(const std::string& path, uint64_t next_sequence, WalDurability durability,
+        std::chrono::milliseconds sync_interval = DEFAULT_SYNC_INTERVAL);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Сбрасывает дописанные записи на диск, если режим это предполагает
+    ~WriteAheadLog();
+
+    // Повторяет на server записи журнала с номерами больше after_sequence. Оборванная или повреждённая
+    // запись (сбой во время дописывания) отрезается от файла вместе со всем, что за ней.
+    // Возвращает номер последней записи журнала или after_sequence, если записей нет.
+    static uint64_t Replay(const std::string& path, uint64_t after_sequence, SearchServer& server);
+
+    // Дописывают запись и возвращают её номер. Записываются и изменения, которые сервер отвергнет:
+    // повтор детерминирован и отвергнет их так же.
+    uint64_t AppendAddDocuments(const std::vector<NewDocument>& documents);
+    uint64_t AppendRemoveDocuments(const std::vector<int>& document_ids);
+
+    // В режиме PER_WRITE ждёт, пока запись sequence окажется на диске. Первый из ждущих делает fsync
+    // за всех, чьи записи уже дописаны (групповая фиксация), остальные ждут его.
+    void WaitDurable(uint64_t sequence);
+
+    // Сбрасывает на диск все дописанные записи в любом режиме
+    void Sync();
+
+    // Очищает журнал, когда все его записи вошли в сохранённый снимок. Номера записей продолжаются.
+    void Truncate();
+
+    uint64_t GetLastSequence() const;
+
+private:
+    enum class RecordType : uint32_t {
+        ADD_DOCUMENTS = 1,
+        REMOVE_DOCUMENTS = 2,
+    };
+
+    int fd_ = -1;
+    // размер файла без недописанной записи; под mutex_
+    uint64_t size_ = 0;
+    WalDurability durability_;
+    std::chrono::milliseconds sync_interval_;
+
+    // номера последней дописанной и последней сброшенной на диск записи; под mutex_
+    uint64_t last_sequence_ = 0;
+    uint64_t durable_sequence_ = 0;
+    bool is_syncing_ = false;
+    bool stop_syncing_ = false;
+    // ошибка фонового fsync; бросается из следующего дописывания
+    std::exception_ptr sync_error_;
+    mutable std::mutex mutex_;
+    std::condition_variable sync_condition_;
+    std::thread sync_thread_;
+
+    static void ApplyRecord(uint32_t type, std::string_view payload, SearchServer& server);
+
+    uint64_t Append(RecordType type, const std::string& payload);
+
+    // Сбрасывает на диск записи до sequence включительно; вызывается с захваченным lock
+    void SyncUpTo(std::unique_lock<std::mutex>& lock, uint64_t sequence);
+
+    void RunBackgroundSync();
+};